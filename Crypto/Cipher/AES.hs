@@ -25,10 +25,19 @@ module Crypto.Cipher.AES
 
     -- * Authenticated encryption block cipher types
     , AESGCM
+    , AESGCMKey
+    , AESGMAC
+    , MutableAESGCM
+    , MutableAESOCB
+
+    -- * Counter mode stream type
+    , MutableAESCTR
 
     -- * creation
     , initAES
     , initKey
+    , initGCMKey
+    , gcmInitWith
 
     -- * misc
     , genCTR
@@ -36,32 +45,101 @@ module Crypto.Cipher.AES
 
     -- * encryption
     , encryptECB
+    , encryptBlockMany
     , encryptCBC
+    , encryptCBCMany
     , encryptCTR
+    , encryptCTRAt
     , encryptXTS
     , encryptGCM
+    , encryptGCMWith
+    , encryptGCMMany
     , encryptOCB
 
     -- * decryption
     , decryptECB
     , decryptCBC
     , decryptCTR
+    , decryptCTRAt
     , decryptXTS
     , decryptGCM
+    , decryptGCMWith
+    , decryptGCMMany
     , decryptOCB
+
+    -- * authentication only
+    , gmac
+    , gmacInit
+    , gmacUpdate
+    , gmacFinish
+
+    -- * mutable authenticated encryption
+    , gcmInitIO
+    , gcmInitWithIO
+    , gcmAppendAADIO
+    , gcmAppendEncryptIO
+    , gcmAppendDecryptIO
+    , gcmFinishIO
+    , ocbInitIO
+    , ocbAppendAADIO
+    , ocbAppendEncryptIO
+    , ocbAppendDecryptIO
+    , ocbFinishIO
+
+    -- * mutable counter mode stream
+    , ctrInitIO
+    , ctrEncryptIO
+    , ctrDecryptIO
+
+    -- * parallel encryption and decryption
+    , ParallelConfig(..)
+    , defaultParallelConfig
+    , encryptECBPar
+    , encryptCTRPar
+    , encryptXTSPar
+    , encryptGCMPar
+    , encryptOCBPar
+    , decryptECBPar
+    , decryptCBCPar
+    , decryptCTRPar
+    , decryptXTSPar
+    , decryptGCMPar
+    , decryptOCBPar
+
+    -- * keystream generator
+    , Generator
+    , GeneratorConfig(..)
+    , defaultGeneratorConfig
+    , newGenerator
+    , generateBytes
+
+    -- * expanded key cache
+    , KeyCache
+    , KeyCacheStats(..)
+    , newKeyCache
+    , initAESCached
+    , keyCacheStats
     ) where
 
+import Control.Concurrent (forkIOWithUnmask, killThread, newEmptyMVar, putMVar, readMVar, myThreadId, threadCapability, getNumCapabilities)
+import Control.Exception (SomeException, mask, onException, throwIO, try, uninterruptibleMask_)
+import Control.Monad (forM, forM_)
+import Data.IORef (IORef, newIORef, readIORef, atomicModifyIORef')
 import Data.Word
 import Foreign.Ptr
 import Foreign.ForeignPtr
 import Foreign.C.Types
 import Foreign.C.String
+import Foreign.Marshal.Array (withArray)
+import Foreign.Marshal.Utils (withMany)
 import Data.ByteString.Internal
 import Data.ByteString.Unsafe
 import Data.Byteable
 import qualified Data.ByteString as B
+import qualified Data.Map as M
 import qualified Data.ByteString.Internal as B (ByteString(PS), mallocByteString, memcpy)
 import System.IO.Unsafe (unsafePerformIO)
+import GHC.Conc (numCapabilities)
 
 import Crypto.Cipher.Types
 import Data.SecureMem
@@ -169,14 +247,40 @@ INSTANCE_BLOCKCIPHER(AES256)
 -- | AESGCM State
 newtype AESGCM = AESGCM SecureMem
 
+-- | AESGCM key context: the AES key with H and its multiplication
+-- table, which only depend on the key and can be shared by all messages.
+data AESGCMKey = AESGCMKey AES SecureMem
+
+-- | AESGMAC State
+newtype AESGMAC = AESGMAC SecureMem
+
 -- | AESOCB State
 newtype AESOCB = AESOCB SecureMem
 
+-- | Mutable AESGCM State, updated in place by the IO functions
+data MutableAESGCM = MutableAESGCM AES SecureMem
+
+-- | Mutable AESOCB State, updated in place by the IO functions
+data MutableAESOCB = MutableAESOCB AES SecureMem
+
+-- | Mutable counter mode stream, with the counter and the unused end of
+-- the last keystream block, updated in place by the IO functions
+data MutableAESCTR = MutableAESCTR AES SecureMem
+
 sizeGCM :: Int
-sizeGCM = 80
+sizeGCM = 336
+
+sizeGCMKey :: Int
+sizeGCMKey = 272
+
+sizeGMAC :: Int
+sizeGMAC = 368
+
+sizeCTRStream :: Int
+sizeCTRStream = 48
 
 sizeOCB :: Int
-sizeOCB = 160
+sizeOCB = 176
 
 keyToPtr :: AES -> (Ptr AES -> IO a) -> IO a
 keyToPtr (AES b) f = withSecureMemPtr b (f . castPtr)
@@ -220,12 +324,11 @@ withOCBKeyAndCopySt aes (AESOCB gcmSt) f =
 -- Key need to be of length 16, 24 or 32 bytes. any other values will cause undefined behavior
 initAES :: Byteable b => b -> AES
 initAES k
-    | len == 16 = initWithRounds 10
-    | len == 24 = initWithRounds 12
-    | len == 32 = initWithRounds 14
+    | len `elem` [16,24,32] = AES $ unsafePerformIO $ do
+        size <- c_aes_key_size (fromIntegral len)
+        createSecureMem (fromIntegral size) aesInit
     | otherwise = error "AES: not a valid key length (valid=16,24,32)"
   where len = byteableLength k
-        initWithRounds nbR = AES $ unsafeCreateSecureMem (16+2*2*16*nbR) aesInit
         aesInit ptr = withBytePtr k $ \ikey ->
             c_aes_init (castPtr ptr) (castPtr ikey) (fromIntegral len)
 
@@ -238,6 +341,28 @@ initKey = initAES
 encryptECB :: AES -> ByteString -> ByteString
 encryptECB = doECB c_aes_encrypt_ecb
 
+-- | encrypt many single blocks, each one with its own key
+--
+-- the result is the same as 'encryptECB' on each block, but the blocks are
+-- encrypted together, which is much faster than one by one when AESNI is
+-- available. useful when deriving one block from each of many keys.
+{-# NOINLINE encryptBlockMany #-}
+encryptBlockMany :: [(AES, ByteString)] -- ^ AES Context and plaintext block of each key
+                 -> [ByteString]        -- ^ ciphertext blocks
+encryptBlockMany blocks = splitBlocks output
+  where nb     = length blocks
+        output = unsafeCreate (16 * nb) $ \o ->
+            withMany keyToPtr (map fst blocks) $ \ks ->
+            withArray ks $ \kptrs ->
+            unsafeUseAsCString (B.concat $ map checkBlock blocks) $ \i ->
+                c_aes_encrypt_blocks_many (castPtr o) kptrs i (fromIntegral nb)
+        checkBlock (_, input)
+            | B.length input /= 16 = error $ "Encryption error: input length must be block size (16). Its length is: " ++ (show $ B.length input)
+            | otherwise = input
+        splitBlocks b
+            | B.null b  = []
+            | otherwise = let (x, r) = B.splitAt 16 b in x : splitBlocks r
+
 -- | encrypt using Cipher Block Chaining (CBC)
 {-# NOINLINE encryptCBC #-}
 encryptCBC :: Byteable iv
@@ -247,6 +372,37 @@ encryptCBC :: Byteable iv
            -> ByteString -- ^ ciphertext
 encryptCBC = doCBC c_aes_encrypt_cbc
 
+-- | encrypt many independent streams using Cipher Block Chaining (CBC)
+--
+-- each stream is a key, an IV and a plaintext, and the ciphertexts are
+-- returned in the same order. the result is the same as 'encryptCBC' on each
+-- stream, but blocks from different streams are encrypted together, which
+-- is much faster than doing the streams one by one when AESNI is available.
+{-# NOINLINE encryptCBCMany #-}
+encryptCBCMany :: Byteable iv
+               => [(AES, iv, ByteString)] -- ^ AES Context, Initial vector of AES block size and plaintext of each stream
+               -> [ByteString]            -- ^ ciphertext of each stream
+encryptCBCMany streams = unsafePerformIO $ do
+    outputs <- mapM (B.mallocByteString . B.length) inputs
+    withMany withStream (zip streams outputs) $ \ptrs ->
+        withArray [ o | (o,_,_,_) <- ptrs ] $ \os ->
+        withArray [ k | (_,k,_,_) <- ptrs ] $ \ks ->
+        withArray [ v | (_,_,v,_) <- ptrs ] $ \vs ->
+        withArray [ i | (_,_,_,i) <- ptrs ] $ \is ->
+        withArray (map (fromIntegral . (`div` 16) . B.length) inputs) $ \nbs ->
+            c_aes_encrypt_cbc_many os ks vs is nbs (fromIntegral $ length streams)
+    return $ zipWith (\fptr input -> B.PS fptr 0 (B.length input)) outputs inputs
+  where inputs = map checkStream streams
+        checkStream (_, iv, input)
+            | byteableLength iv /= 16 = error $ "AES error: IV length must be block size (16). Its length is: " ++ (show $ byteableLength iv)
+            | B.length input `mod` 16 /= 0 = error $ "Encryption error: input length must be a multiple of block size (16). Its length is: " ++ (show $ B.length input)
+            | otherwise = input
+        withStream ((ctx, iv, input), fptr) f =
+            withForeignPtr fptr $ \o ->
+            withKeyAndIV ctx iv $ \k v ->
+            unsafeUseAsCString input $ \i ->
+            f (castPtr o, k, castPtr v, castPtr i)
+
 -- | generate a counter mode pad. this is generally xor-ed to an input
 -- to make the standard counter mode block operations.
 --
@@ -316,6 +472,26 @@ encryptCTR ctx iv input
                       c_aes_encrypt_ctr (castPtr o) k v i (fromIntegral len)
         len = B.length input
 
+-- | encrypt using Counter mode (CTR), starting at a byte offset of the stream.
+--
+-- the result is the same as the bytes from the offset in the output of
+-- 'encryptCTR' for a longer input, without encrypting what comes before.
+-- this allows random access, such as decrypting a range of a file.
+{-# NOINLINE encryptCTRAt #-}
+encryptCTRAt :: Byteable iv
+             => AES        -- ^ AES Context
+             -> iv         -- ^ initial vector of AES block size (usually representing a 128 bit integer)
+             -> Word64     -- ^ offset in bytes of the input in the stream
+             -> ByteString -- ^ plaintext input
+             -> ByteString -- ^ ciphertext output
+encryptCTRAt ctx iv offset input
+    | len <= 0  = B.empty
+    | byteableLength iv /= 16 = error $ "AES error: IV length must be block size (16). Its length is: " ++ (show $ byteableLength iv)
+    | otherwise = unsafeCreate len doEncrypt
+  where doEncrypt o = withKeyAndIV ctx iv $ \k v -> unsafeUseAsCString input $ \i ->
+                      c_aes_encrypt_ctr_at (castPtr o) k v offset i (fromIntegral len)
+        len = B.length input
+
 -- | encrypt using Galois counter mode (GCM)
 -- return the encrypted bytestring and the tag associated
 --
@@ -330,6 +506,31 @@ encryptGCM :: Byteable iv
            -> (ByteString, AuthTag) -- ^ ciphertext and tag
 encryptGCM = doGCM gcmAppendEncrypt
 
+-- | encrypt using Galois counter mode (GCM), same as 'encryptGCM'
+-- but with a key context precomputed by 'initGCMKey'.
+{-# NOINLINE encryptGCMWith #-}
+encryptGCMWith :: Byteable iv
+               => AESGCMKey  -- ^ GCM key context
+               -> iv         -- ^ IV initial vector of any size
+               -> ByteString -- ^ data to authenticate (AAD)
+               -> ByteString -- ^ data to encrypt
+               -> (ByteString, AuthTag) -- ^ ciphertext and tag
+encryptGCMWith = doGCMWith gcmAppendEncrypt
+
+-- | encrypt many packets using Galois counter mode (GCM) under the same key,
+-- in one call. each packet is an IV, data to authenticate (AAD) and data to
+-- encrypt, and the ciphertext and tag of each packet are returned in order.
+--
+-- the result is the same as calling 'encryptGCMWith' on each packet, without
+-- the per packet allocations and context copies. packets shorter than 8
+-- blocks are interleaved, so that they are encrypted 8 blocks at a time.
+{-# NOINLINE encryptGCMMany #-}
+encryptGCMMany :: Byteable iv
+               => AESGCMKey                        -- ^ GCM key context
+               -> [(iv, ByteString, ByteString)]   -- ^ IV, AAD and plaintext of each packet
+               -> [(ByteString, AuthTag)]          -- ^ ciphertext and tag of each packet
+encryptGCMMany = doGCMMany c_aes_gcm_encrypt_many
+
 -- | encrypt using OCB v3
 -- return the encrypted bytestring and the tag associated
 {-# NOINLINE encryptOCB #-}
@@ -374,6 +575,17 @@ decryptCTR :: Byteable iv
            -> ByteString -- ^ plaintext output
 decryptCTR = encryptCTR
 
+-- | decrypt using Counter mode (CTR), starting at a byte offset of the stream.
+--
+-- in CTR mode encryption and decryption is the same operation.
+decryptCTRAt :: Byteable iv
+             => AES        -- ^ AES Context
+             -> iv         -- ^ initial vector, usually representing a 128 bit integer
+             -> Word64     -- ^ offset in bytes of the input in the stream
+             -> ByteString -- ^ ciphertext input
+             -> ByteString -- ^ plaintext output
+decryptCTRAt = encryptCTRAt
+
 -- | decrypt using XTS
 {-# NOINLINE decryptXTS #-}
 decryptXTS :: Byteable iv
@@ -394,6 +606,26 @@ decryptGCM :: Byteable iv
            -> (ByteString, AuthTag) -- ^ plaintext and tag
 decryptGCM = doGCM gcmAppendDecrypt
 
+-- | decrypt using Galois Counter Mode (GCM), same as 'decryptGCM'
+-- but with a key context precomputed by 'initGCMKey'.
+{-# NOINLINE decryptGCMWith #-}
+decryptGCMWith :: Byteable iv
+               => AESGCMKey  -- ^ GCM key context
+               -> iv         -- ^ IV initial vector of any size
+               -> ByteString -- ^ data to authenticate (AAD)
+               -> ByteString -- ^ data to decrypt
+               -> (ByteString, AuthTag) -- ^ plaintext and tag
+decryptGCMWith = doGCMWith gcmAppendDecrypt
+
+-- | decrypt many packets using Galois Counter Mode (GCM) under the same key,
+-- in one call. see 'encryptGCMMany'.
+{-# NOINLINE decryptGCMMany #-}
+decryptGCMMany :: Byteable iv
+               => AESGCMKey                        -- ^ GCM key context
+               -> [(iv, ByteString, ByteString)]   -- ^ IV, AAD and ciphertext of each packet
+               -> [(ByteString, AuthTag)]          -- ^ plaintext and tag of each packet
+decryptGCMMany = doGCMMany c_aes_gcm_decrypt_many
+
 -- | decrypt using Offset Codebook Mode (OCB)
 {-# NOINLINE decryptOCB #-}
 decryptOCB :: Byteable iv
@@ -459,11 +691,62 @@ doGCM :: Byteable iv
       -> ByteString
       -> ByteString
       -> (ByteString, AuthTag)
-doGCM f ctx iv aad input = (output, tag)
+doGCM f ctx iv = doGCMFrom f ctx (gcmInit ctx iv)
+
+{-# INLINE doGCMWith #-}
+doGCMWith :: Byteable iv
+          => (AES -> AESGCM -> ByteString -> (ByteString, AESGCM))
+          -> AESGCMKey
+          -> iv
+          -> ByteString
+          -> ByteString
+          -> (ByteString, AuthTag)
+doGCMWith f gkey@(AESGCMKey ctx _) iv = doGCMFrom f ctx (gcmInitWith gkey iv)
+
+{-# INLINE doGCMFrom #-}
+doGCMFrom :: (AES -> AESGCM -> ByteString -> (ByteString, AESGCM))
+          -> AES
+          -> AESGCM
+          -> ByteString
+          -> ByteString
+          -> (ByteString, AuthTag)
+doGCMFrom f ctx ini aad input = (output, tag)
   where tag             = gcmFinish ctx after 16
         (output, after) = f ctx afterAAD input
         afterAAD        = gcmAppendAAD ini aad
-        ini             = gcmInit ctx iv
+
+{-# INLINE doGCMMany #-}
+doGCMMany :: Byteable iv
+          => (Ptr (Ptr Word8) -> Ptr Word8 -> Ptr AESGCMKey -> Ptr AES
+              -> Ptr (Ptr Word8) -> Ptr CUInt -> Ptr (Ptr Word8) -> Ptr CUInt
+              -> Ptr (Ptr Word8) -> Ptr CUInt -> CUInt -> IO ())
+          -> AESGCMKey
+          -> [(iv, ByteString, ByteString)]
+          -> [(ByteString, AuthTag)]
+doGCMMany f (AESGCMKey ctx gkey) packets = unsafePerformIO $ do
+    outputs <- mapM (B.mallocByteString . B.length) inputs
+    tags    <- create (16 * nbPackets) $ \t ->
+        withMany withPacket (zip packets outputs) $ \ptrs ->
+        withArray [ o | (o,_,_,_) <- ptrs ] $ \os ->
+        withArray [ v | (_,v,_,_) <- ptrs ] $ \vs ->
+        withArray [ a | (_,_,a,_) <- ptrs ] $ \as ->
+        withArray [ i | (_,_,_,i) <- ptrs ] $ \is ->
+        withArray (map (\(iv,_,_) -> fromIntegral $ byteableLength iv) packets) $ \vls ->
+        withArray (map (\(_,aad,_) -> fromIntegral $ B.length aad) packets) $ \als ->
+        withArray (map (fromIntegral . B.length) inputs) $ \ils ->
+        withSecureMemPtr gkey $ \g ->
+        keyToPtr ctx $ \k ->
+            f os t (castPtr g) k vs vls as als is ils (fromIntegral nbPackets)
+    return [ (B.PS fptr 0 (B.length input), AuthTag $ B.take 16 $ B.drop (16 * n) tags)
+           | (n, fptr, input) <- zip3 [0..] outputs inputs ]
+  where inputs    = map (\(_,_,input) -> input) packets
+        nbPackets = length packets
+        withPacket ((iv, aad, input), fptr) g =
+            withForeignPtr fptr $ \o ->
+            ivToPtr iv $ \v ->
+            unsafeUseAsCString aad $ \a ->
+            unsafeUseAsCString input $ \i ->
+            g (o, v, castPtr a, castPtr i)
 
 -- | initialize a gcm context
 {-# NOINLINE gcmInit #-}
@@ -474,6 +757,30 @@ gcmInit ctx iv = unsafePerformIO $ do
             c_aes_gcm_init (castPtr gcmStPtr) k v (fromIntegral $ byteableLength iv)
     return $ AESGCM sm
 
+-- | precompute the GCM key context of an AES key.
+--
+-- the result can be used with 'gcmInitWith', 'encryptGCMWith' and
+-- 'decryptGCMWith' for any number of messages, saving the computation
+-- of H and its multiplication table on each of them.
+{-# NOINLINE initGCMKey #-}
+initGCMKey :: AES -> AESGCMKey
+initGCMKey ctx = unsafePerformIO $ do
+    sm <- createSecureMem sizeGCMKey $ \gkeyPtr ->
+            keyToPtr ctx $ \k ->
+            c_aes_gcm_initkey (castPtr gkeyPtr) k
+    return $ AESGCMKey ctx sm
+
+-- | initialize a gcm context from a precomputed GCM key context.
+-- only the IV dependent part of the context is computed.
+{-# NOINLINE gcmInitWith #-}
+gcmInitWith :: Byteable iv => AESGCMKey -> iv -> AESGCM
+gcmInitWith (AESGCMKey _ gkey) iv = unsafePerformIO $ do
+    sm <- createSecureMem sizeGCM $ \gcmStPtr ->
+            withSecureMemPtr gkey $ \g ->
+            ivToPtr iv $ \v ->
+            c_aes_gcm_init_with (castPtr gcmStPtr) (castPtr g) v (fromIntegral $ byteableLength iv)
+    return $ AESGCM sm
+
 -- | append data which is going to just be authentified to the GCM context.
 --
 -- need to happen after initialization and before appending encryption/decryption data.
@@ -518,6 +825,53 @@ gcmFinish ctx gcm taglen = AuthTag $ B.take taglen computeTag
   where computeTag = unsafeCreate 16 $ \t ->
                         withGCMKeyAndCopySt ctx gcm (c_aes_gcm_finish (castPtr t)) >> return ()
 
+------------------------------------------------------------------------
+-- GMAC
+------------------------------------------------------------------------
+
+-- | compute the GMAC of a message, which is GCM with all the data
+-- authenticated and nothing to encrypt.
+{-# NOINLINE gmac #-}
+gmac :: Byteable iv
+     => AES        -- ^ Key
+     -> iv         -- ^ IV initial vector of any size
+     -> ByteString -- ^ data to authenticate
+     -> AuthTag
+gmac ctx iv input = AuthTag computeTag
+  where computeTag = unsafeCreate 16 $ \t ->
+                        withKeyAndIV ctx iv $ \k v ->
+                        unsafeUseAsCString input $ \i ->
+                        c_aes_gmac (castPtr t) k v (fromIntegral $ byteableLength iv) i (fromIntegral $ B.length input)
+
+-- | initialize a gmac context
+{-# NOINLINE gmacInit #-}
+gmacInit :: Byteable iv => AES -> iv -> AESGMAC
+gmacInit ctx iv = unsafePerformIO $ do
+    sm <- createSecureMem sizeGMAC $ \gmacStPtr ->
+            withKeyAndIV ctx iv $ \k v ->
+            c_aes_gmac_init (castPtr gmacStPtr) k v (fromIntegral $ byteableLength iv)
+    return $ AESGMAC sm
+
+-- | append data to authenticate to the GMAC context.
+--
+-- unlike the GCM functions, the bytestring can be of any length.
+{-# NOINLINE gmacUpdate #-}
+gmacUpdate :: AESGMAC -> ByteString -> AESGMAC
+gmacUpdate (AESGMAC gmacSt) input = unsafePerformIO doAppend
+  where doAppend =
+            withSecureMemCopy gmacSt (\gmacStPtr ->
+                unsafeUseAsCString input $ \i ->
+                c_aes_gmac_update (castPtr gmacStPtr) i (fromIntegral $ B.length input))
+            >>= \sm2 -> return (AESGMAC sm2)
+
+-- | Generate the Tag from GMAC context
+{-# NOINLINE gmacFinish #-}
+gmacFinish :: AES -> AESGMAC -> Int -> AuthTag
+gmacFinish ctx (AESGMAC gmacSt) taglen = AuthTag $ B.take taglen computeTag
+  where computeTag = unsafeCreate 16 $ \t ->
+                        keyToPtr ctx $ \k ->
+                        withSecureMemCopy gmacSt (\gmacStPtr -> c_aes_gmac_finish (castPtr t) (castPtr gmacStPtr) k) >> return ()
+
 ------------------------------------------------------------------------
 -- OCB v3
 ------------------------------------------------------------------------
@@ -589,6 +943,548 @@ ocbFinish ctx ocb taglen = AuthTag $ B.take taglen computeTag
                         withOCBKeyAndCopySt ctx ocb (c_aes_ocb_finish (castPtr t)) >> return ()
 
 ------------------------------------------------------------------------
+-- Mutable GCM and OCB
+--
+-- same operations as the pure GCM and OCB functions, but the context is
+-- modified in place instead of being copied on each call, which matters
+-- when streaming lots of small chunks.
+------------------------------------------------------------------------
+
+-- | create a new mutable gcm context
+gcmInitIO :: Byteable iv => AES -> iv -> IO MutableAESGCM
+gcmInitIO ctx iv = do
+    sm <- createSecureMem sizeGCM $ \gcmStPtr ->
+            withKeyAndIV ctx iv $ \k v ->
+            c_aes_gcm_init (castPtr gcmStPtr) k v (fromIntegral $ byteableLength iv)
+    return $ MutableAESGCM ctx sm
+
+-- | create a new mutable gcm context from a precomputed GCM key context
+gcmInitWithIO :: Byteable iv => AESGCMKey -> iv -> IO MutableAESGCM
+gcmInitWithIO (AESGCMKey ctx gkey) iv = do
+    sm <- createSecureMem sizeGCM $ \gcmStPtr ->
+            withSecureMemPtr gkey $ \g ->
+            ivToPtr iv $ \v ->
+            c_aes_gcm_init_with (castPtr gcmStPtr) (castPtr g) v (fromIntegral $ byteableLength iv)
+    return $ MutableAESGCM ctx sm
+
+-- | append data which is going to just be authentified to the mutable GCM context.
+--
+-- same restrictions as 'gcmAppendAAD'.
+gcmAppendAADIO :: MutableAESGCM -> ByteString -> IO ()
+gcmAppendAADIO (MutableAESGCM _ sm) input =
+    withSecureMemPtr sm $ \gcmStPtr ->
+    unsafeUseAsCString input $ \i ->
+    c_aes_gcm_aad (castPtr gcmStPtr) i (fromIntegral $ B.length input)
+
+-- | encrypt data and append it to the mutable GCM context.
+--
+-- same restrictions as 'gcmAppendEncrypt'.
+gcmAppendEncryptIO :: MutableAESGCM -> ByteString -> IO ByteString
+gcmAppendEncryptIO = gcmCryptIO c_aes_gcm_encrypt
+
+-- | decrypt data and append it to the mutable GCM context.
+--
+-- same restrictions as 'gcmAppendDecrypt'.
+gcmAppendDecryptIO :: MutableAESGCM -> ByteString -> IO ByteString
+gcmAppendDecryptIO = gcmCryptIO c_aes_gcm_decrypt
+
+{-# INLINE gcmCryptIO #-}
+gcmCryptIO :: (CString -> Ptr AESGCM -> Ptr AES -> CString -> CUInt -> IO ())
+           -> MutableAESGCM -> ByteString -> IO ByteString
+gcmCryptIO f (MutableAESGCM ctx sm) input =
+    create len $ \o ->
+    withSecureMemPtr sm $ \gcmStPtr ->
+    keyToPtr ctx $ \k ->
+    unsafeUseAsCString input $ \i ->
+    f (castPtr o) (castPtr gcmStPtr) k i (fromIntegral len)
+  where len = B.length input
+
+-- | Generate the Tag from the mutable GCM context.
+--
+-- the context is finalized and cannot be used anymore.
+gcmFinishIO :: MutableAESGCM -> Int -> IO AuthTag
+gcmFinishIO (MutableAESGCM ctx sm) taglen = do
+    tag <- create 16 $ \t ->
+            withSecureMemPtr sm $ \gcmStPtr ->
+            keyToPtr ctx $ \k ->
+            c_aes_gcm_finish (castPtr t) (castPtr gcmStPtr) k
+    return $ AuthTag $ B.take taglen tag
+
+-- | create a new mutable ocb context
+ocbInitIO :: Byteable iv => AES -> iv -> IO MutableAESOCB
+ocbInitIO ctx iv = do
+    sm <- createSecureMem sizeOCB $ \ocbStPtr ->
+            withKeyAndIV ctx iv $ \k v ->
+            c_aes_ocb_init (castPtr ocbStPtr) k v (fromIntegral $ byteableLength iv)
+    return $ MutableAESOCB ctx sm
+
+-- | append data which is going to just be authentified to the mutable OCB context.
+--
+-- same restrictions as 'ocbAppendAAD'.
+ocbAppendAADIO :: MutableAESOCB -> ByteString -> IO ()
+ocbAppendAADIO (MutableAESOCB ctx sm) input =
+    withSecureMemPtr sm $ \ocbStPtr ->
+    keyToPtr ctx $ \k ->
+    unsafeUseAsCString input $ \i ->
+    c_aes_ocb_aad (castPtr ocbStPtr) k i (fromIntegral $ B.length input)
+
+-- | encrypt data and append it to the mutable OCB context.
+--
+-- same restrictions as 'ocbAppendEncrypt'.
+ocbAppendEncryptIO :: MutableAESOCB -> ByteString -> IO ByteString
+ocbAppendEncryptIO = ocbCryptIO c_aes_ocb_encrypt
+
+-- | decrypt data and append it to the mutable OCB context.
+--
+-- same restrictions as 'ocbAppendDecrypt'.
+ocbAppendDecryptIO :: MutableAESOCB -> ByteString -> IO ByteString
+ocbAppendDecryptIO = ocbCryptIO c_aes_ocb_decrypt
+
+{-# INLINE ocbCryptIO #-}
+ocbCryptIO :: (CString -> Ptr AESOCB -> Ptr AES -> CString -> CUInt -> IO ())
+           -> MutableAESOCB -> ByteString -> IO ByteString
+ocbCryptIO f (MutableAESOCB ctx sm) input =
+    create len $ \o ->
+    withSecureMemPtr sm $ \ocbStPtr ->
+    keyToPtr ctx $ \k ->
+    unsafeUseAsCString input $ \i ->
+    f (castPtr o) (castPtr ocbStPtr) k i (fromIntegral len)
+  where len = B.length input
+
+-- | Generate the Tag from the mutable OCB context.
+--
+-- the context is finalized and cannot be used anymore.
+ocbFinishIO :: MutableAESOCB -> Int -> IO AuthTag
+ocbFinishIO (MutableAESOCB ctx sm) taglen = do
+    tag <- create 16 $ \t ->
+            withSecureMemPtr sm $ \ocbStPtr ->
+            keyToPtr ctx $ \k ->
+            c_aes_ocb_finish (castPtr t) (castPtr ocbStPtr) k
+    return $ AuthTag $ B.take taglen tag
+
+------------------------------------------------------------------------
+-- Mutable CTR stream
+--
+-- successive calls with any lengths give the same output as one call to
+-- 'encryptCTR' on the concatenated inputs.
+------------------------------------------------------------------------
+
+-- | create a new counter mode stream starting at the IV
+ctrInitIO :: Byteable iv => AES -> iv -> IO MutableAESCTR
+ctrInitIO ctx iv
+    | byteableLength iv /= 16 = error $ "AES error: IV length must be block size (16). Its length is: " ++ (show $ byteableLength iv)
+    | otherwise = do
+        sm <- createSecureMem sizeCTRStream $ \ctrStPtr ->
+                ivToPtr iv $ \v ->
+                c_aes_ctr_stream_init (castPtr ctrStPtr) v
+        return $ MutableAESCTR ctx sm
+
+-- | encrypt the next bytes of the counter mode stream
+ctrEncryptIO :: MutableAESCTR -> ByteString -> IO ByteString
+ctrEncryptIO (MutableAESCTR ctx sm) input =
+    create len $ \o ->
+    withSecureMemPtr sm $ \ctrStPtr ->
+    keyToPtr ctx $ \k ->
+    unsafeUseAsCString input $ \i ->
+    c_aes_ctr_stream_encrypt (castPtr o) (castPtr ctrStPtr) k i (fromIntegral len)
+  where len = B.length input
+
+-- | decrypt the next bytes of the counter mode stream.
+--
+-- in CTR mode encryption and decryption is the same operation.
+ctrDecryptIO :: MutableAESCTR -> ByteString -> IO ByteString
+ctrDecryptIO = ctrEncryptIO
+
+------------------------------------------------------------------------
+-- Parallel ECB, CTR, CBC decryption, XTS, GCM and OCB
+--
+-- a large input is split in block aligned chunks, each one processed by
+-- its own thread with the state the serial path would have at the start
+-- of the chunk, so the output is identical to the serial functions.
+-- the chunks only run on different cores with the threaded runtime.
+------------------------------------------------------------------------
+
+-- | configuration of the parallel functions
+data ParallelConfig = ParallelConfig
+    { parallelThreshold :: Int -- ^ inputs shorter than this, in bytes, are processed by the calling thread only
+    , parallelThreads   :: Int -- ^ number of chunks, and of threads, a larger input is split in
+    } deriving (Show,Eq)
+
+-- | inputs of 1MB and more are split in as many chunks as there are capabilities
+defaultParallelConfig :: ParallelConfig
+defaultParallelConfig = ParallelConfig
+    { parallelThreshold = 1024 * 1024
+    , parallelThreads   = numCapabilities
+    }
+
+-- | split len bytes in (offset, length) chunks that start on a block boundary.
+-- the last chunk also gets the bytes after the last full block.
+parallelChunks :: ParallelConfig -> Int -> [(Int, Int)]
+parallelChunks cfg len
+    | len < parallelThreshold cfg || n <= 1 = [(0, len)]
+    | otherwise = [ (o, if o == lastOff then len - o else chunkLen) | o <- [0, chunkLen .. lastOff] ]
+  where n        = min (parallelThreads cfg) (len `div` 16)
+        chunkLen = 16 * ((len `div` 16) `div` n)
+        lastOff  = chunkLen * (n - 1)
+
+-- | run the action on every element, all but the first in new threads,
+-- and wait for all of them to finish, rethrowing the first exception.
+--
+-- the workers write to memory owned by the caller, so they never outlive
+-- this call: if the calling thread gets an exception, the workers are
+-- killed and waited for before it is rethrown.
+parallelRun :: [a] -> (a -> IO ()) -> IO ()
+parallelRun []     _ = return ()
+parallelRun (x:xs) f = mask $ \restore -> do
+    workers <- forM xs $ \y -> do
+        done <- newEmptyMVar
+        tid  <- forkIOWithUnmask $ \unmask -> try (unmask (f y)) >>= putMVar done
+        return (tid, done)
+    let stop = uninterruptibleMask_ $ do
+            mapM_ (killThread . fst) workers
+            mapM_ (readMVar . snd) workers
+    r  <- try (restore (f x))
+    rs <- either (\e -> stop >> return [Left e]) (const $ mapM (readMVar . snd) workers `onException` stop) r
+    case [ e | Left e <- rs ] of
+        e:_ -> throwIO (e :: SomeException)
+        []  -> return ()
+
+-- | encrypt using Electronic Code Book (ECB), in parallel for large inputs
+{-# NOINLINE encryptECBPar #-}
+encryptECBPar :: ParallelConfig -> AES -> ByteString -> ByteString
+encryptECBPar = doECBPar c_aes_encrypt_ecb
+
+-- | decrypt using Electronic Code Book (ECB), in parallel for large inputs
+{-# NOINLINE decryptECBPar #-}
+decryptECBPar :: ParallelConfig -> AES -> ByteString -> ByteString
+decryptECBPar = doECBPar c_aes_decrypt_ecb
+
+-- | decrypt using Cipher block chaining (CBC), in parallel for large inputs.
+--
+-- the IV of each chunk is the last ciphertext block of the previous one.
+{-# NOINLINE decryptCBCPar #-}
+decryptCBCPar :: Byteable iv => ParallelConfig -> AES -> iv -> ByteString -> ByteString
+decryptCBCPar cfg ctx iv input
+    | len == 0  = B.empty
+    | byteableLength iv /= 16 = error $ "AES error: IV length must be block size (16). Its length is: " ++ (show $ byteableLength iv)
+    | r /= 0    = error $ "Encryption error: input length must be a multiple of block size (16). Its length is: " ++ (show len)
+    | otherwise = unsafePerformIO $ create len $ \o ->
+                  withKeyAndIV ctx iv $ \k v ->
+                  unsafeUseAsCString input $ \i ->
+                  parallelRun (parallelChunks cfg len) $ \(off, n) ->
+                      c_aes_decrypt_cbc (o `plusPtr` off) k
+                                        (if off == 0 then v else i `plusPtr` (off - 16))
+                                        (i `plusPtr` off) (fromIntegral $ n `div` 16)
+  where r   = len `mod` 16
+        len = B.length input
+
+-- | encrypt using Counter mode (CTR), in parallel for large inputs.
+--
+-- each chunk is encrypted at its offset in the stream, see 'encryptCTRAt'.
+{-# NOINLINE encryptCTRPar #-}
+encryptCTRPar :: Byteable iv => ParallelConfig -> AES -> iv -> ByteString -> ByteString
+encryptCTRPar cfg ctx iv input
+    | len <= 0  = B.empty
+    | byteableLength iv /= 16 = error $ "AES error: IV length must be block size (16). Its length is: " ++ (show $ byteableLength iv)
+    | otherwise = unsafePerformIO $ create len $ \o ->
+                  withKeyAndIV ctx iv $ \k v ->
+                  unsafeUseAsCString input $ \i ->
+                  parallelRun (parallelChunks cfg len) $ \(off, n) ->
+                      c_aes_encrypt_ctr_at (o `plusPtr` off) k v (fromIntegral off) (i `plusPtr` off) (fromIntegral n)
+  where len = B.length input
+
+-- | decrypt using Counter mode (CTR), in parallel for large inputs.
+decryptCTRPar :: Byteable iv => ParallelConfig -> AES -> iv -> ByteString -> ByteString
+decryptCTRPar = encryptCTRPar
+
+-- | encrypt using XTS, in parallel for large inputs.
+--
+-- each chunk starts at the tweak of its first block.
+{-# NOINLINE encryptXTSPar #-}
+encryptXTSPar :: Byteable iv => ParallelConfig -> (AES,AES) -> iv -> Word32 -> ByteString -> ByteString
+encryptXTSPar = doXTSPar c_aes_encrypt_xts
+
+-- | decrypt using XTS, in parallel for large inputs.
+{-# NOINLINE decryptXTSPar #-}
+decryptXTSPar :: Byteable iv => ParallelConfig -> (AES,AES) -> iv -> Word32 -> ByteString -> ByteString
+decryptXTSPar = doXTSPar c_aes_decrypt_xts
+
+-- | encrypt using Galois counter mode (GCM), in parallel for large inputs.
+--
+-- each chunk starts at the counter of its first block and is hashed from
+-- zero, and the partial tags are combined with the right powers of H.
+{-# NOINLINE encryptGCMPar #-}
+encryptGCMPar :: Byteable iv => ParallelConfig -> AES -> iv -> ByteString -> ByteString -> (ByteString, AuthTag)
+encryptGCMPar = doGCMPar c_aes_gcm_encrypt
+
+-- | decrypt using Galois counter mode (GCM), in parallel for large inputs.
+{-# NOINLINE decryptGCMPar #-}
+decryptGCMPar :: Byteable iv => ParallelConfig -> AES -> iv -> ByteString -> ByteString -> (ByteString, AuthTag)
+decryptGCMPar = doGCMPar c_aes_gcm_decrypt
+
+-- | encrypt using OCB v3, in parallel for large inputs.
+--
+-- each chunk starts at the offset of its first block with its own
+-- checksum, and the checksums are combined for the tag.
+{-# NOINLINE encryptOCBPar #-}
+encryptOCBPar :: Byteable iv => ParallelConfig -> AES -> iv -> ByteString -> ByteString -> (ByteString, AuthTag)
+encryptOCBPar = doOCBPar c_aes_ocb_encrypt
+
+-- | decrypt using OCB v3, in parallel for large inputs.
+{-# NOINLINE decryptOCBPar #-}
+decryptOCBPar :: Byteable iv => ParallelConfig -> AES -> iv -> ByteString -> ByteString -> (ByteString, AuthTag)
+decryptOCBPar = doOCBPar c_aes_ocb_decrypt
+
+{-# INLINE doECBPar #-}
+doECBPar :: (Ptr b -> Ptr AES -> CString -> CUInt -> IO ())
+         -> ParallelConfig -> AES -> ByteString -> ByteString
+doECBPar f cfg ctx input
+    | r /= 0    = error $ "Encryption error: input length must be a multiple of block size (16). Its length is: " ++ (show len)
+    | otherwise = unsafePerformIO $ create len $ \o ->
+                  keyToPtr ctx $ \k ->
+                  unsafeUseAsCString input $ \i ->
+                  parallelRun (parallelChunks cfg len) $ \(off, n) ->
+                      f (o `plusPtr` off) k (i `plusPtr` off) (fromIntegral $ n `div` 16)
+  where r   = len `mod` 16
+        len = B.length input
+
+{-# INLINE doXTSPar #-}
+doXTSPar :: Byteable iv
+         => (Ptr b -> Ptr AES -> Ptr AES -> Ptr Word8 -> CUInt -> CString -> CUInt -> IO ())
+         -> ParallelConfig -> (AES, AES) -> iv -> Word32 -> ByteString -> ByteString
+doXTSPar f cfg (key1,key2) iv spoint input
+    | len == 0  = B.empty
+    | r /= 0    = error $ "Encryption error: input length must be a multiple of block size (16) for now. Its length is: " ++ (show len)
+    | otherwise = unsafePerformIO $ create len $ \o -> withKey2AndIV key1 key2 iv $ \k1 k2 v -> unsafeUseAsCString input $ \i ->
+            parallelRun chunks $ \(off, n) ->
+                f (o `plusPtr` off) k1 k2 v (fromIntegral spoint + fromIntegral (off `div` 16))
+                  (i `plusPtr` off) (fromIntegral $ n `div` 16)
+  where r   = len `mod` 16
+        len = B.length input
+        -- the sector point of a chunk is a 32 bits value: when the blocks
+        -- go past 2^32, everything is done from spoint in a single chunk.
+        chunks
+            | toInteger spoint + toInteger (len `div` 16) > toInteger (maxBound :: Word32) = [(0, len)]
+            | otherwise = parallelChunks cfg len
+
+{-# INLINE doGCMPar #-}
+doGCMPar :: Byteable iv
+         => (CString -> Ptr AESGCM -> Ptr AES -> CString -> CUInt -> IO ())
+         -> ParallelConfig -> AES -> iv -> ByteString -> ByteString -> (ByteString, AuthTag)
+doGCMPar f cfg ctx iv aad input = doAEADPar sizeGCM c_aes_gcm_fork c_aes_gcm_join f c_aes_gcm_finish cfg ctx st input
+  where AESGCM st = gcmAppendAAD (gcmInit ctx iv) aad
+
+{-# INLINE doOCBPar #-}
+doOCBPar :: Byteable iv
+         => (CString -> Ptr AESOCB -> Ptr AES -> CString -> CUInt -> IO ())
+         -> ParallelConfig -> AES -> iv -> ByteString -> ByteString -> (ByteString, AuthTag)
+doOCBPar f cfg ctx iv aad input = doAEADPar sizeOCB c_aes_ocb_fork c_aes_ocb_join f c_aes_ocb_finish cfg ctx st input
+  where AESOCB st = ocbAppendAAD ctx (ocbInit ctx iv) aad
+
+-- | process the chunks of input in parallel from the context st, each in
+-- its own copy of the context forked at the chunk's first block, then join
+-- the copies back in order to finish the tag.
+{-# INLINE doAEADPar #-}
+doAEADPar :: Int                                                      -- ^ size of the context
+          -> (Ptr st -> Ptr st -> CUInt -> IO ())                     -- ^ fork
+          -> (Ptr st -> Ptr st -> IO ())                              -- ^ join
+          -> (CString -> Ptr st -> Ptr AES -> CString -> CUInt -> IO ()) -- ^ encrypt or decrypt
+          -> (CString -> Ptr st -> Ptr AES -> IO ())                  -- ^ finish
+          -> ParallelConfig -> AES -> SecureMem -> ByteString -> (ByteString, AuthTag)
+doAEADPar size fork join f finish cfg ctx st input = unsafePerformIO $ do
+    parts <- forM chunks $ \(off, _) ->
+                createSecureMem size $ \p ->
+                withSecureMemPtr st $ \s ->
+                fork (castPtr p) (castPtr s) (fromIntegral $ off `div` 16)
+    output <- create len $ \o ->
+                keyToPtr ctx $ \k ->
+                unsafeUseAsCString input $ \i ->
+                parallelRun (zip chunks parts) $ \((off, n), part) ->
+                    withSecureMemPtr part $ \p ->
+                    f (o `plusPtr` off) (castPtr p) k (i `plusPtr` off) (fromIntegral n)
+    final <- secureMemCopy st
+    tag <- create 16 $ \t ->
+            withSecureMemPtr final $ \s ->
+            keyToPtr ctx $ \k -> do
+                forM_ parts $ \part -> withSecureMemPtr part $ \p -> join (castPtr s) (castPtr p)
+                finish (castPtr t) (castPtr s) k
+    return (output, AuthTag tag)
+  where len    = B.length input
+        chunks = parallelChunks cfg len
+
+------------------------------------------------------------------------
+-- Keystream generator
+--
+-- AES-256 in counter mode used as a random bytes generator. the keystream
+-- is generated a large buffer at a time, and requests are served as slices
+-- of the buffer. every capability has its own pool, with its own key, so
+-- threads running on different capabilities never touch the same state.
+------------------------------------------------------------------------
+
+-- | configuration of the keystream generator
+data GeneratorConfig = GeneratorConfig
+    { generatorBufferSize :: Int -- ^ bytes of keystream generated at once by a pool
+    , generatorRekeyAfter :: Int -- ^ bytes of keystream a pool generates before it picks a new key
+    } deriving (Show,Eq)
+
+-- | 64KB buffers, and a new key every 16MB
+defaultGeneratorConfig :: GeneratorConfig
+defaultGeneratorConfig = GeneratorConfig
+    { generatorBufferSize = 64 * 1024
+    , generatorRekeyAfter = 16 * 1024 * 1024
+    }
+
+-- | AES counter mode keystream generator
+data Generator = Generator GeneratorConfig [IORef GeneratorPool]
+
+data GeneratorPool = GeneratorPool
+    { poolKey     :: !AES
+    , poolIV      :: !AESIV
+    , poolBuffer  :: !ByteString -- ^ keystream not handed out yet
+    , poolCounter :: !Int        -- ^ bytes of keystream generated since the last key
+    }
+
+-- | a seed is a 256 bits key followed by a 128 bits counter
+generatorSeedLength :: Int
+generatorSeedLength = 48
+
+generatorPool :: ByteString -> GeneratorPool
+generatorPool seed = GeneratorPool (initAES k) (aesIV_ iv) B.empty 0
+  where (k, iv) = B.splitAt 32 seed
+
+-- | create a new generator from a 48 bytes seed.
+--
+-- the seed only keys a first pool, whose keystream keys a pool for
+-- each capability.
+newGenerator :: GeneratorConfig -> ByteString -> IO Generator
+newGenerator cfg seed
+    | B.length seed /= generatorSeedLength = error "AES: generator seed must be 48 bytes"
+    | otherwise = do
+        n <- getNumCapabilities
+        let root  = generatorPool seed
+            seeds = fst $ genCounter (poolKey root) (poolIV root) (n * generatorSeedLength)
+        pools <- forM [0..n-1] $ \i ->
+                    newIORef $ generatorPool $ B.take generatorSeedLength $ B.drop (i * generatorSeedLength) seeds
+        return $ Generator cfg pools
+
+-- | get the next len bytes of the pool of the calling thread's capability.
+--
+-- the bytes are a slice of the pool's buffer and are not copied, so they
+-- keep the whole buffer alive.
+generateBytes :: Generator -> Int -> IO ByteString
+generateBytes (Generator cfg pools) len
+    | len <= 0  = return B.empty
+    | otherwise = do
+        (cap, _) <- threadCapability =<< myThreadId
+        atomicModifyIORef' (pools !! (cap `mod` length pools)) (generatorTake cfg len)
+
+generatorTake :: GeneratorConfig -> Int -> GeneratorPool -> (GeneratorPool, ByteString)
+generatorTake cfg len pool
+    | len <= B.length buf = (pool { poolBuffer = B.drop len buf }, B.take len buf)
+    -- a request larger than a buffer is generated on its own, and leaves the buffer alone.
+    | len >= bufSize      = let (out, iv') = genCounter key iv len
+                             in (generatorRekey cfg $ pool { poolIV = iv', poolCounter = counter + B.length out }, B.take len out)
+    | otherwise           = let (out, iv') = genCounter key iv bufSize
+                             in generatorTake cfg len $ generatorRekey cfg $ GeneratorPool key iv' out (counter + B.length out)
+  where GeneratorPool key iv buf counter = pool
+        bufSize = generatorBufferSize cfg
+
+-- | once a pool has generated enough keystream, the next bytes of the
+-- keystream, never handed out, become its new key and counter.
+generatorRekey :: GeneratorConfig -> GeneratorPool -> GeneratorPool
+generatorRekey cfg pool
+    | poolCounter pool < generatorRekeyAfter cfg = pool
+    | otherwise = (generatorPool seed) { poolBuffer = poolBuffer pool }
+  where seed = fst $ genCounter (poolKey pool) (poolIV pool) generatorSeedLength
+
+------------------------------------------------------------------------
+-- Expanded key cache
+--
+-- a bounded cache of expanded contexts, for services that see the same
+-- keys again and again. entries are indexed by a MAC of the key bytes
+-- under the cache's own secret key, so the indexes reveal nothing of the
+-- keys. the cached contexts themselves hold the key schedules, the first
+-- round key being the key itself, like any AES context.
+------------------------------------------------------------------------
+
+-- | bounded least recently used cache of AES contexts
+data KeyCache = KeyCache Int AES (IORef KeyCacheState)
+
+data KeyCacheState = KeyCacheState
+    { cacheEntries :: !(M.Map ByteString (Int, AES)) -- ^ context and last use, by key tag
+    , cacheUses    :: !(M.Map Int ByteString)        -- ^ key tag, by last use
+    , cacheTick    :: !Int
+    , cacheHits    :: !Int
+    , cacheMisses  :: !Int
+    }
+
+-- | counters of a key cache
+data KeyCacheStats = KeyCacheStats
+    { keyCacheHits   :: Int -- ^ lookups that found an expanded context
+    , keyCacheMisses :: Int -- ^ lookups that had to expand the key
+    , keyCacheSize   :: Int -- ^ contexts currently held
+    } deriving (Show,Eq)
+
+-- | create a cache holding at most capacity contexts.
+--
+-- the secret keys the hash of the key bytes, and must be a valid AES key.
+-- it should be random, so that the indexes of the cache reveal nothing
+-- of the keys.
+newKeyCache :: Byteable secret => Int -> secret -> IO KeyCache
+newKeyCache capacity secret =
+    KeyCache capacity (initAES secret) `fmap` newIORef (KeyCacheState M.empty M.empty 0 0 0)
+
+-- | CBC-MAC of the key zero padded to 32 bytes followed by a block holding
+-- its length. all the inputs have the same length, so this is a PRF.
+keyCacheTag :: AES -> ByteString -> ByteString
+keyCacheTag secret k = B.drop 32 $ encryptCBC secret (B.replicate 16 0) input
+  where input = B.concat [k, B.replicate (32 - B.length k) 0, B.replicate 15 0, B.singleton (fromIntegral $ B.length k)]
+
+-- | get the context of a key from the cache, expanding the key and adding
+-- it to the cache, in place of the least recently used context, when it's
+-- not there yet.
+initAESCached :: Byteable b => KeyCache -> b -> IO AES
+initAESCached (KeyCache capacity secret ref) k
+    | B.length kb `notElem` [16,24,32] = error "AES: not a valid key length (valid=16,24,32)"
+    | otherwise = do
+        ctx <- atomicModifyIORef' ref lookupKey
+        return $! ctx
+  where
+        kb  = toBytes k
+        tag = keyCacheTag secret kb
+        lookupKey st = case M.lookup tag (cacheEntries st) of
+            Just (used, ctx) ->
+                (st { cacheEntries = M.insert tag (tick, ctx) (cacheEntries st)
+                    , cacheUses    = M.insert tick tag $ M.delete used (cacheUses st)
+                    , cacheTick    = tick + 1
+                    , cacheHits    = cacheHits st + 1
+                    }, ctx)
+            Nothing
+                | capacity <= 0 -> (st { cacheMisses = cacheMisses st + 1 }, ctx)
+                | otherwise     ->
+                    let (entries, uses) = evict (cacheEntries st) (cacheUses st)
+                     in (st { cacheEntries = M.insert tag (tick, ctx) entries
+                            , cacheUses    = M.insert tick tag uses
+                            , cacheTick    = tick + 1
+                            , cacheMisses  = cacheMisses st + 1
+                            }, ctx)
+              where ctx = initAES kb
+          where tick = cacheTick st
+        evict entries uses
+            | M.size entries < capacity = (entries, uses)
+            | otherwise = let ((_, oldest), uses') = M.deleteFindMin uses
+                           in (M.delete oldest entries, uses')
+
+-- | get the hit and miss counters, and the size, of a key cache
+keyCacheStats :: KeyCache -> IO KeyCacheStats
+keyCacheStats (KeyCache _ _ ref) = do
+    st <- readIORef ref
+    return $ KeyCacheStats (cacheHits st) (cacheMisses st) (M.size $ cacheEntries st)
+
+------------------------------------------------------------------------
+foreign import ccall "aes.h aes_key_size"
+    c_aes_key_size :: CUInt -> IO CUInt
+
 foreign import ccall "aes.h aes_initkey"
     c_aes_init :: Ptr AES -> CString -> CUInt -> IO ()
 
@@ -599,6 +1495,9 @@ foreign import ccall "aes.h aes_encrypt_ecb"
 foreign import ccall "aes.h aes_decrypt_ecb"
     c_aes_decrypt_ecb :: CString -> Ptr AES -> CString -> CUInt -> IO ()
 
+foreign import ccall "aes.h aes_encrypt_blocks_many"
+    c_aes_encrypt_blocks_many :: CString -> Ptr (Ptr AES) -> CString -> CUInt -> IO ()
+
 ------------------------------------------------------------------------
 foreign import ccall "aes.h aes_encrypt_cbc"
     c_aes_encrypt_cbc :: CString -> Ptr AES -> Ptr Word8 -> CString -> CUInt -> IO ()
@@ -606,6 +1505,9 @@ foreign import ccall "aes.h aes_encrypt_cbc"
 foreign import ccall "aes.h aes_decrypt_cbc"
     c_aes_decrypt_cbc :: CString -> Ptr AES -> Ptr Word8 -> CString -> CUInt -> IO ()
 
+foreign import ccall "aes.h aes_encrypt_cbc_many"
+    c_aes_encrypt_cbc_many :: Ptr (Ptr Word8) -> Ptr (Ptr AES) -> Ptr (Ptr Word8) -> Ptr (Ptr Word8) -> Ptr CUInt -> CUInt -> IO ()
+
 ------------------------------------------------------------------------
 foreign import ccall "aes.h aes_encrypt_xts"
     c_aes_encrypt_xts :: CString -> Ptr AES -> Ptr AES -> Ptr Word8 -> CUInt -> CString -> CUInt -> IO ()
@@ -623,10 +1525,35 @@ foreign import ccall unsafe "aes.h aes_gen_ctr_cont"
 foreign import ccall "aes.h aes_encrypt_ctr"
     c_aes_encrypt_ctr :: CString -> Ptr AES -> Ptr Word8 -> CString -> CUInt -> IO ()
 
+foreign import ccall "aes.h aes_encrypt_ctr_at"
+    c_aes_encrypt_ctr_at :: CString -> Ptr AES -> Ptr Word8 -> Word64 -> CString -> CUInt -> IO ()
+
+foreign import ccall "aes.h aes_ctr_stream_init"
+    c_aes_ctr_stream_init :: Ptr MutableAESCTR -> Ptr Word8 -> IO ()
+
+foreign import ccall "aes.h aes_ctr_stream_encrypt"
+    c_aes_ctr_stream_encrypt :: CString -> Ptr MutableAESCTR -> Ptr AES -> CString -> CUInt -> IO ()
+
 ------------------------------------------------------------------------
 foreign import ccall "aes.h aes_gcm_init"
     c_aes_gcm_init :: Ptr AESGCM -> Ptr AES -> Ptr Word8 -> CUInt -> IO ()
 
+foreign import ccall "aes.h aes_gcm_initkey"
+    c_aes_gcm_initkey :: Ptr AESGCMKey -> Ptr AES -> IO ()
+
+foreign import ccall "aes.h aes_gcm_init_with"
+    c_aes_gcm_init_with :: Ptr AESGCM -> Ptr AESGCMKey -> Ptr Word8 -> CUInt -> IO ()
+
+foreign import ccall "aes.h aes_gcm_encrypt_many"
+    c_aes_gcm_encrypt_many :: Ptr (Ptr Word8) -> Ptr Word8 -> Ptr AESGCMKey -> Ptr AES
+                           -> Ptr (Ptr Word8) -> Ptr CUInt -> Ptr (Ptr Word8) -> Ptr CUInt
+                           -> Ptr (Ptr Word8) -> Ptr CUInt -> CUInt -> IO ()
+
+foreign import ccall "aes.h aes_gcm_decrypt_many"
+    c_aes_gcm_decrypt_many :: Ptr (Ptr Word8) -> Ptr Word8 -> Ptr AESGCMKey -> Ptr AES
+                           -> Ptr (Ptr Word8) -> Ptr CUInt -> Ptr (Ptr Word8) -> Ptr CUInt
+                           -> Ptr (Ptr Word8) -> Ptr CUInt -> CUInt -> IO ()
+
 foreign import ccall "aes.h aes_gcm_aad"
     c_aes_gcm_aad :: Ptr AESGCM -> CString -> CUInt -> IO ()
 
@@ -639,6 +1566,25 @@ foreign import ccall "aes.h aes_gcm_decrypt"
 foreign import ccall "aes.h aes_gcm_finish"
     c_aes_gcm_finish :: CString -> Ptr AESGCM -> Ptr AES -> IO ()
 
+foreign import ccall "aes.h aes_gcm_fork"
+    c_aes_gcm_fork :: Ptr AESGCM -> Ptr AESGCM -> CUInt -> IO ()
+
+foreign import ccall "aes.h aes_gcm_join"
+    c_aes_gcm_join :: Ptr AESGCM -> Ptr AESGCM -> IO ()
+
+------------------------------------------------------------------------
+foreign import ccall "aes.h aes_gmac"
+    c_aes_gmac :: CString -> Ptr AES -> Ptr Word8 -> CUInt -> CString -> CUInt -> IO ()
+
+foreign import ccall "aes.h aes_gmac_init"
+    c_aes_gmac_init :: Ptr AESGMAC -> Ptr AES -> Ptr Word8 -> CUInt -> IO ()
+
+foreign import ccall "aes.h aes_gmac_update"
+    c_aes_gmac_update :: Ptr AESGMAC -> CString -> CUInt -> IO ()
+
+foreign import ccall "aes.h aes_gmac_finish"
+    c_aes_gmac_finish :: CString -> Ptr AESGMAC -> Ptr AES -> IO ()
+
 ------------------------------------------------------------------------
 foreign import ccall "aes.h aes_ocb_init"
     c_aes_ocb_init :: Ptr AESOCB -> Ptr AES -> Ptr Word8 -> CUInt -> IO ()
@@ -652,5 +1598,11 @@ foreign import ccall "aes.h aes_ocb_encrypt"
 foreign import ccall "aes.h aes_ocb_decrypt"
     c_aes_ocb_decrypt :: CString -> Ptr AESOCB -> Ptr AES -> CString -> CUInt -> IO ()
 
+foreign import ccall "aes.h aes_ocb_fork"
+    c_aes_ocb_fork :: Ptr AESOCB -> Ptr AESOCB -> CUInt -> IO ()
+
+foreign import ccall "aes.h aes_ocb_join"
+    c_aes_ocb_join :: Ptr AESOCB -> Ptr AESOCB -> IO ()
+
 foreign import ccall "aes.h aes_ocb_finish"
     c_aes_ocb_finish :: CString -> Ptr AESOCB -> Ptr AES -> IO ()
@@ -58,6 +58,34 @@ vectors_aes128_enc =
         , {-tag = -}"\x94\xd1\x47\xc3\xa2\xca\x93\xe9\x66\x93\x1e\x3b\xb3\xbb\x67\x01")
     ]
 
+vectors_aes192_enc :: [KATGCM]
+vectors_aes192_enc =
+    [ -- vectors 0
+        ( {-key = -}"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        , {-iv = -}"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        , {-aad = -}""
+        , {-input = -}""
+        , {-out = -}""
+        , {-taglen = -}16
+        , {-tag = -}"\xcd\x33\xb2\x8a\xc7\x73\xf7\x4b\xa0\x0e\xd1\xf3\x12\x57\x24\x35")
+    -- vectors 1
+    ,   ( {-key = -}"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        , {-iv = -}"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        , {-aad = -}""
+        , {-input = -}"\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        , {-out = -}"\x98\xe7\x24\x7c\x07\xf0\xfe\x41\x1c\x26\x7e\x43\x84\xb0\xf6\x00"
+        , {-taglen = -}16
+        , {-tag = -}"\x2f\xf5\x8d\x80\x03\x39\x27\xab\x8e\xf4\xd4\x58\x75\x14\xf0\xfb")
+    -- vectors 2
+    ,   ( {-key = -}"\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10\x11\x12\x13\x14\x15\x16\x17\x18"
+        , {-iv = -}"\xff\xfe\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+        , {-aad = -}"\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01\x01"
+        , {-input = -}"\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a\x0a"
+        , {-out = -}"\x78\x5a\x41\x5e\x30\x7a\x71\x33\xf9\x73\x66\xb9\x90\x24\x6e\xaf\x6d\xa6\xea\x1d\xe8\x0e\x3e\x22\x39\xb8\x2c\x4f\x2d\xde\x1c\x51\xb2\xb9\x0c\x08\x95\xb0\x07\x30\xfd\x3e\xd1\x57\xc7\x57\x95\xdf"
+        , {-taglen = -}16
+        , {-tag = -}"\x42\xe0\x71\x0e\xeb\xff\x18\x2f\xe0\x85\x54\x6b\x54\x4e\xfd\xb6")
+    ]
+
 vectors_aes256_enc :: [KATGCM]
 vectors_aes256_enc =
     [
@@ -87,6 +115,7 @@ vectors_aes256_enc =
 
 vectors_encrypt =
     [ ("AES128 Enc", vectors_aes128_enc)
+    , ("AES192 Enc", vectors_aes192_enc)
     , ("AES256 Enc", vectors_aes256_enc)
     ]
 
@@ -1,16 +1,23 @@
 {-# LANGUAGE ViewPatterns #-}
 {-# LANGUAGE OverloadedStrings #-}
+{-# LANGUAGE ForeignFunctionInterface #-}
 module Main where
 
 import Control.Applicative
 import Control.Monad
+import Control.Exception (catch, throwIO)
+import System.IO.Unsafe (unsafePerformIO)
+import System.Environment (getArgs)
+import System.Exit (ExitCode(..))
+import Foreign.C.Types (CInt(..))
 
-import Test.Framework (Test, defaultMain, testGroup)
+import Test.Framework (Test, defaultMainWithArgs, testGroup)
 import Test.Framework.Providers.QuickCheck2 (testProperty)
 
 import Test.QuickCheck
 import Test.QuickCheck.Test
 
+import Data.Word (Word8)
 import Data.Byteable
 import qualified Data.ByteString as B
 import qualified Crypto.Cipher.AES as AES
@@ -28,7 +35,14 @@ instance Show AES.AES where
 instance Arbitrary AES.AESIV where
     arbitrary = AES.aesIV_ . B.pack <$> replicateM 16 arbitrary
 instance Arbitrary AES.AES where
-    arbitrary = AES.initAES . B.pack <$> replicateM 16 arbitrary
+    arbitrary = elements [16,24,32] >>= arbitraryKey
+
+arbitraryKey :: Int -> Gen AES.AES
+arbitraryKey n = AES.initAES . B.pack <$> replicateM n arbitrary
+
+-- | keys of every size, next to each other
+mixedKeys :: Gen [AES.AES]
+mixedKeys = mapM arbitraryKey [16,24,32,32,16,24,24,32,16]
 
 toKatECB (k,p,c) = KAT_ECB { ecbKey = k, ecbPlaintext = p, ecbCiphertext = c }
 toKatCBC (k,iv,p,c) = KAT_CBC { cbcKey = k, cbcIV = iv, cbcPlaintext = p, cbcCiphertext = c }
@@ -63,6 +77,7 @@ kats128 = defaultKATs
 kats192 = defaultKATs
     { kat_ECB  = map toKatECB KATECB.vectors_aes192_enc
     , kat_CBC  = map toKatCBC KATCBC.vectors_aes192_enc
+    , kat_AEAD = map toKatGCM KATGCM.vectors_aes192_enc
     }
 
 kats256 = defaultKATs
@@ -72,7 +87,41 @@ kats256 = defaultKATs
     , kat_AEAD = map toKatGCM KATGCM.vectors_aes256_enc
     }
 
-main = defaultMain
+-- split in chunks of n blocks, only the last one being possibly partial
+splitBlocks :: Int -> B.ByteString -> [B.ByteString]
+splitBlocks n bs
+    | B.length bs <= 16 * n = [bs]
+    | otherwise             = let (b1, b2) = B.splitAt (16 * n) bs in b1 : splitBlocks n b2
+
+-- | split in chunks of n bytes, then n + 1, n + 2, ...
+splitBytes :: Int -> B.ByteString -> [B.ByteString]
+splitBytes n bs
+    | B.null bs = []
+    | otherwise = let (b1, b2) = B.splitAt n bs in b1 : splitBytes (n + 1) b2
+
+-- | restrict the implementation selection to the given cpu features
+-- (aesni, pclmul, ssse3), so that every backend gets exercised.
+-- it's a no-op when the library is built without aesni support.
+foreign import ccall unsafe "aes_force_implementation"
+    c_aes_force_implementation :: CInt -> CInt -> CInt -> IO ()
+
+backends :: [(String, (CInt, CInt, CInt))]
+backends =
+    [ ("aesni+pclmul", (1,1,1))
+    , ("aesni",        (1,0,0))
+    , ("vperm",        (0,0,1))
+    , ("bitsliced",    (0,0,0))
+    ]
+
+main = do
+    args <- getArgs
+    forM_ backends $ \(name, (aesni, pclmul, ssse3)) -> do
+        c_aes_force_implementation aesni pclmul ssse3
+        defaultMainWithArgs [testGroup name tests] args `catch` \e -> case e of
+            ExitSuccess -> return ()
+            _           -> throwIO e
+
+tests =
     [ testBlockCipher kats128 (undefined :: AES.AES128)
     , testBlockCipher kats192 (undefined :: AES.AES192)
     , testBlockCipher kats256 (undefined :: AES.AES256)
@@ -81,4 +130,115 @@ main = defaultMain
             (bs2, iv3)    = AES.genCounter key iv2 32
             (bsAll, iv3') = AES.genCounter key iv1 64
          in (B.concat [bs1,bs2] == bsAll && iv3 == iv3')
+    , testProperty "blockMany" $ \blocks ->
+        let blocks' = [ (key, toBytes (block :: AES.AESIV)) | (key, block) <- blocks ]
+         in AES.encryptBlockMany blocks' == [ AES.encryptECB k b | (k, b) <- blocks' ]
+    , testProperty "cbcMany" $ \streams ->
+        let mk (key, iv, bs) = (key, iv :: AES.AESIV, B.pack $ take (16 * (length bs `div` 16)) bs)
+            streams'         = map mk streams
+         in AES.encryptCBCMany streams' == [ AES.encryptCBC k iv bs | (k, iv, bs) <- streams' ]
+    , testProperty "blockManyMixed" $ forAll mixedKeys $ \keys blocks ->
+        let blocks' = zip keys (map toBytes (blocks :: [AES.AESIV]))
+         in AES.encryptBlockMany blocks' == [ AES.encryptECB k b | (k, b) <- blocks' ]
+    , testProperty "cbcManyMixed" $ forAll mixedKeys $ \keys streams ->
+        let mk key (iv, bs) = (key, iv :: AES.AESIV, B.pack $ take (16 * (length bs `div` 16)) bs)
+            streams'        = zipWith mk keys streams
+         in AES.encryptCBCMany streams' == [ AES.encryptCBC k iv bs | (k, iv, bs) <- streams' ]
+    , testProperty "ctrAt" $ \(key, iv, B.pack -> prefix, B.pack -> input) ->
+        let offset = B.length prefix
+         in AES.encryptCTRAt key (iv :: AES.AESIV) (fromIntegral offset) input ==
+            B.drop offset (AES.encryptCTR key iv (B.append prefix input))
+    , testProperty "ctrStream" $ \(key, iv, B.pack -> input, Positive n) ->
+        let out = unsafePerformIO $ do
+                    st <- AES.ctrInitIO key (iv :: AES.AESIV)
+                    B.concat <$> mapM (AES.ctrEncryptIO st) (splitBytes (n `mod` 40) input)
+         in out == AES.encryptCTR key iv input
+    , testProperty "generator" $ forAll (B.pack <$> vector 48) $ \seed sizes (Positive n) ->
+        let cfg  = AES.GeneratorConfig { AES.generatorBufferSize = n `mod` 100 + 1, AES.generatorRekeyAfter = n `mod` 300 }
+            lens = map fromIntegral (sizes :: [Word8])
+            run  = do g <- AES.newGenerator cfg seed
+                      mapM (AES.generateBytes g) lens
+            (out1, out2) = unsafePerformIO $ (,) <$> run <*> run
+         in map B.length out1 == lens && out1 == out2
+    , testProperty "generatorStream" $ forAll (B.pack <$> vector 48) $ \seed (Positive d) (Positive m) ->
+        let size   = 2 ^ (d `mod` 9)
+            cfg    = AES.GeneratorConfig { AES.generatorBufferSize = 256, AES.generatorRekeyAfter = 256 * (m `mod` 3 + 1) }
+            out    = unsafePerformIO $ do
+                        g <- AES.newGenerator cfg seed
+                        B.concat <$> replicateM (5 * 256 `div` size) (AES.generateBytes g size)
+            keyed s = (AES.initAES (B.take 32 s), AES.aesIV_ (B.drop 32 s))
+            -- the first pool is keyed by the first 48 bytes of the seed's keystream
+            (key0, iv0) = keyed $ fst $ uncurry AES.genCounter (keyed seed) 48
+            expected :: AES.AES -> AES.AESIV -> Int -> Int -> [B.ByteString]
+            expected _ _ _ 0 = []
+            expected key iv used nb =
+                let (buf, iv') = AES.genCounter key iv 256
+                    used'      = used + 256
+                 in buf : if used' >= AES.generatorRekeyAfter cfg
+                            then uncurry expected (keyed $ fst $ AES.genCounter key iv' 48) 0 (nb - 1)
+                            else expected key iv' used' (nb - 1)
+         in out == B.concat (expected key0 iv0 0 5)
+    , testProperty "keyCache" $ \(Positive capacity) (map B.pack -> keys) ->
+        let keys' = [ B.take 16 (B.append k (B.replicate 16 0)) | k <- keys ]
+            (ctxs, stats) = unsafePerformIO $ do
+                    cache <- AES.newKeyCache (capacity `mod` 8) (B.replicate 16 1)
+                    (,) <$> mapM (AES.initAESCached cache) (keys' ++ keys') <*> AES.keyCacheStats cache
+            block = B.replicate 16 2
+         in map (`AES.encryptECB` block) ctxs == map ((`AES.encryptECB` block) . AES.initAES) (keys' ++ keys') &&
+            AES.keyCacheHits stats + AES.keyCacheMisses stats == 2 * length keys' &&
+            AES.keyCacheSize stats <= capacity `mod` 8
+    , testProperty "xtsSpoint" $ \(key1, key2, iv, B.pack -> input, Positive n) ->
+        let spoint = n `mod` 1024
+            blocks = B.take (16 * (B.length input `div` 16)) input
+            prefix = B.replicate (16 * spoint) 0
+         in AES.encryptXTS (key1, key2) (iv :: AES.AESIV) (fromIntegral spoint) blocks ==
+            B.drop (16 * spoint) (AES.encryptXTS (key1, key2) iv 0 (B.append prefix blocks)) &&
+            AES.decryptXTS (key1, key2) iv (fromIntegral spoint) blocks ==
+            B.drop (16 * spoint) (AES.decryptXTS (key1, key2) iv 0 (B.append prefix blocks))
+    , testProperty "parallel" $ \(key, key2, iv, B.pack -> aad, B.pack -> input, Positive n) ->
+        let cfg     = AES.ParallelConfig { AES.parallelThreshold = 0, AES.parallelThreads = n `mod` 8 + 1 }
+            blocks  = B.take (16 * (B.length input `div` 16)) input
+            spoint  = maxBound - fromIntegral (B.length aad)
+         in AES.encryptECBPar cfg key blocks == AES.encryptECB key blocks &&
+            AES.decryptECBPar cfg key blocks == AES.decryptECB key blocks &&
+            AES.decryptCBCPar cfg key (iv :: AES.AESIV) blocks == AES.decryptCBC key iv blocks &&
+            AES.encryptCTRPar cfg key iv input == AES.encryptCTR key iv input &&
+            AES.encryptXTSPar cfg (key, key2) iv spoint blocks == AES.encryptXTS (key, key2) iv spoint blocks &&
+            AES.decryptXTSPar cfg (key, key2) iv spoint blocks == AES.decryptXTS (key, key2) iv spoint blocks &&
+            AES.encryptGCMPar cfg key iv aad input == AES.encryptGCM key iv aad input &&
+            AES.decryptGCMPar cfg key iv aad input == AES.decryptGCM key iv aad input &&
+            AES.encryptOCBPar cfg key iv aad input == AES.encryptOCB key iv aad input &&
+            AES.decryptOCBPar cfg key iv aad input == AES.decryptOCB key iv aad input
+    , testProperty "gcmWithKey" $ \(key, iv, B.pack -> aad, B.pack -> input) ->
+        let gkey = AES.initGCMKey key
+         in AES.encryptGCMWith gkey (iv :: AES.AESIV) aad input == AES.encryptGCM key iv aad input &&
+            AES.decryptGCMWith gkey iv aad input == AES.decryptGCM key iv aad input
+    , testProperty "gcmIO" $ \(key, iv, B.pack -> aad, B.pack -> input, Positive n) ->
+        let chunks = splitBlocks n input
+            st     = unsafePerformIO $ do
+                        ctx <- AES.gcmInitIO key (iv :: AES.AESIV)
+                        AES.gcmAppendAADIO ctx aad
+                        out <- mapM (AES.gcmAppendEncryptIO ctx) chunks
+                        tag <- AES.gcmFinishIO ctx 16
+                        return (B.concat out, tag)
+         in st == AES.encryptGCM key iv aad input
+    , testProperty "ocbIO" $ \(key, iv, B.pack -> aad, B.pack -> input, Positive n) ->
+        let chunks = splitBlocks n input
+            st     = unsafePerformIO $ do
+                        ctx <- AES.ocbInitIO key (iv :: AES.AESIV)
+                        mapM_ (AES.ocbAppendAADIO ctx) (splitBlocks n aad)
+                        out <- mapM (AES.ocbAppendEncryptIO ctx) chunks
+                        tag <- AES.ocbFinishIO ctx 16
+                        return (B.concat out, tag)
+         in st == AES.encryptOCB key iv aad input
+    , testProperty "gcmMany" $ \(key, packets) ->
+        let gkey     = AES.initGCMKey key
+            packets' = [ (iv :: AES.AESIV, B.pack aad, B.pack input) | (iv, aad, input) <- packets ]
+         in AES.encryptGCMMany gkey packets' == [ AES.encryptGCM key iv aad input | (iv, aad, input) <- packets' ] &&
+            AES.decryptGCMMany gkey packets' == [ AES.decryptGCM key iv aad input | (iv, aad, input) <- packets' ]
+    , testProperty "gmac" $ \(key, iv, B.pack -> input, n) ->
+        let (i1, i2) = B.splitAt n input
+            st       = AES.gmacInit key (iv :: AES.AESIV)
+         in AES.gmac key iv input == snd (AES.encryptGCM key iv input B.empty) &&
+            AES.gmacFinish key (AES.gmacUpdate (AES.gmacUpdate st i1) i2) 16 == AES.gmac key iv input
     ]
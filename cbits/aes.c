@@ -31,12 +31,14 @@
 #include "cpu.h"
 #include "aes.h"
 #include "aes_generic.h"
+#include "aes_bitslice.h"
 #include "bitfn.h"
 #include <string.h>
 #include <stdio.h>
 
 #include "gf.h"
 #include "aes_x86ni.h"
+#include "aes_vperm.h"
 
 void aes_generic_encrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks);
 void aes_generic_decrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks);
@@ -51,6 +53,13 @@ void aes_generic_gcm_encrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_
 void aes_generic_gcm_decrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length);
 void aes_generic_ocb_encrypt(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length);
 void aes_generic_ocb_decrypt(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length);
+void aes_generic_ocb_aad(aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length);
+void aes_bs_gcm_encrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length);
+void aes_bs_gcm_decrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length);
+static void gen_ctr_ecb(aes_block *output, aes_key *key, aes_block *iv, uint32_t nb_blocks);
+static void block8_serial_encrypt(aes_block *output, aes_key **keys, aes_block *input);
+static void cbc4_serial_encrypt(aes_block **output, aes_key **keys, aes_block *ivs, aes_block **input, uint32_t nb_blocks);
+static void cbc8_serial_encrypt(aes_block **output, aes_key **keys, aes_block *ivs, aes_block **input, uint32_t nb_blocks);
 
 enum {
 	/* init */
@@ -58,14 +67,18 @@ enum {
 	/* single block */
 	ENCRYPT_BLOCK_128, ENCRYPT_BLOCK_192, ENCRYPT_BLOCK_256,
 	DECRYPT_BLOCK_128, DECRYPT_BLOCK_192, DECRYPT_BLOCK_256,
+	ENCRYPT_BLOCK8_128, ENCRYPT_BLOCK8_192, ENCRYPT_BLOCK8_256,
 	/* ecb */
 	ENCRYPT_ECB_128, ENCRYPT_ECB_192, ENCRYPT_ECB_256,
 	DECRYPT_ECB_128, DECRYPT_ECB_192, DECRYPT_ECB_256,
 	/* cbc */
 	ENCRYPT_CBC_128, ENCRYPT_CBC_192, ENCRYPT_CBC_256,
 	DECRYPT_CBC_128, DECRYPT_CBC_192, DECRYPT_CBC_256,
+	ENCRYPT_CBC4_128, ENCRYPT_CBC4_192, ENCRYPT_CBC4_256,
+	ENCRYPT_CBC8_128, ENCRYPT_CBC8_192, ENCRYPT_CBC8_256,
 	/* ctr */
 	ENCRYPT_CTR_128, ENCRYPT_CTR_192, ENCRYPT_CTR_256,
+	GEN_CTR_128, GEN_CTR_192, GEN_CTR_256,
 	/* xts */
 	ENCRYPT_XTS_128, ENCRYPT_XTS_192, ENCRYPT_XTS_256,
 	DECRYPT_XTS_128, DECRYPT_XTS_192, DECRYPT_XTS_256,
@@ -75,13 +88,16 @@ enum {
 	/* ocb */
 	ENCRYPT_OCB_128, ENCRYPT_OCB_192, ENCRYPT_OCB_256,
 	DECRYPT_OCB_128, DECRYPT_OCB_192, DECRYPT_OCB_256,
+	AAD_OCB_128, AAD_OCB_192, AAD_OCB_256,
+	/* ghash */
+	GHASH_INIT, GHASH_MUL, GHASH_BLOCKS,
 };
 
 void *branch_table[] = {
 	/* INIT */
-	[INIT_128]          = aes_generic_init,
-	[INIT_192]          = aes_generic_init,
-	[INIT_256]          = aes_generic_init,
+	[INIT_128]          = aes_bs_initkey,
+	[INIT_192]          = aes_bs_initkey,
+	[INIT_256]          = aes_bs_initkey,
 	/* BLOCK */
 	[ENCRYPT_BLOCK_128] = aes_generic_encrypt_block,
 	[ENCRYPT_BLOCK_192] = aes_generic_encrypt_block,
@@ -89,24 +105,36 @@ void *branch_table[] = {
 	[DECRYPT_BLOCK_128] = aes_generic_decrypt_block,
 	[DECRYPT_BLOCK_192] = aes_generic_decrypt_block,
 	[DECRYPT_BLOCK_256] = aes_generic_decrypt_block,
+	[ENCRYPT_BLOCK8_128] = block8_serial_encrypt,
+	[ENCRYPT_BLOCK8_192] = block8_serial_encrypt,
+	[ENCRYPT_BLOCK8_256] = block8_serial_encrypt,
 	/* ECB */
-	[ENCRYPT_ECB_128]   = aes_generic_encrypt_ecb,
-	[ENCRYPT_ECB_192]   = aes_generic_encrypt_ecb,
-	[ENCRYPT_ECB_256]   = aes_generic_encrypt_ecb,
-	[DECRYPT_ECB_128]   = aes_generic_decrypt_ecb,
-	[DECRYPT_ECB_192]   = aes_generic_decrypt_ecb,
-	[DECRYPT_ECB_256]   = aes_generic_decrypt_ecb,
+	[ENCRYPT_ECB_128]   = aes_bs_encrypt_ecb,
+	[ENCRYPT_ECB_192]   = aes_bs_encrypt_ecb,
+	[ENCRYPT_ECB_256]   = aes_bs_encrypt_ecb,
+	[DECRYPT_ECB_128]   = aes_bs_decrypt_ecb,
+	[DECRYPT_ECB_192]   = aes_bs_decrypt_ecb,
+	[DECRYPT_ECB_256]   = aes_bs_decrypt_ecb,
 	/* CBC */
 	[ENCRYPT_CBC_128]   = aes_generic_encrypt_cbc,
 	[ENCRYPT_CBC_192]   = aes_generic_encrypt_cbc,
 	[ENCRYPT_CBC_256]   = aes_generic_encrypt_cbc,
-	[DECRYPT_CBC_128]   = aes_generic_decrypt_cbc,
-	[DECRYPT_CBC_192]   = aes_generic_decrypt_cbc,
-	[DECRYPT_CBC_256]   = aes_generic_decrypt_cbc,
+	[DECRYPT_CBC_128]   = aes_bs_decrypt_cbc,
+	[DECRYPT_CBC_192]   = aes_bs_decrypt_cbc,
+	[DECRYPT_CBC_256]   = aes_bs_decrypt_cbc,
+	[ENCRYPT_CBC4_128]  = cbc4_serial_encrypt,
+	[ENCRYPT_CBC4_192]  = cbc4_serial_encrypt,
+	[ENCRYPT_CBC4_256]  = cbc4_serial_encrypt,
+	[ENCRYPT_CBC8_128]  = cbc8_serial_encrypt,
+	[ENCRYPT_CBC8_192]  = cbc8_serial_encrypt,
+	[ENCRYPT_CBC8_256]  = cbc8_serial_encrypt,
 	/* CTR */
-	[ENCRYPT_CTR_128]   = aes_generic_encrypt_ctr,
-	[ENCRYPT_CTR_192]   = aes_generic_encrypt_ctr,
-	[ENCRYPT_CTR_256]   = aes_generic_encrypt_ctr,
+	[ENCRYPT_CTR_128]   = aes_bs_encrypt_ctr,
+	[ENCRYPT_CTR_192]   = aes_bs_encrypt_ctr,
+	[ENCRYPT_CTR_256]   = aes_bs_encrypt_ctr,
+	[GEN_CTR_128]       = gen_ctr_ecb,
+	[GEN_CTR_192]       = gen_ctr_ecb,
+	[GEN_CTR_256]       = gen_ctr_ecb,
 	/* XTS */
 	[ENCRYPT_XTS_128]   = aes_generic_encrypt_xts,
 	[ENCRYPT_XTS_192]   = aes_generic_encrypt_xts,
@@ -115,12 +143,12 @@ void *branch_table[] = {
 	[DECRYPT_XTS_192]   = aes_generic_decrypt_xts,
 	[DECRYPT_XTS_256]   = aes_generic_decrypt_xts,
 	/* GCM */
-	[ENCRYPT_GCM_128]   = aes_generic_gcm_encrypt,
-	[ENCRYPT_GCM_192]   = aes_generic_gcm_encrypt,
-	[ENCRYPT_GCM_256]   = aes_generic_gcm_encrypt,
-	[DECRYPT_GCM_128]   = aes_generic_gcm_decrypt,
-	[DECRYPT_GCM_192]   = aes_generic_gcm_decrypt,
-	[DECRYPT_GCM_256]   = aes_generic_gcm_decrypt,
+	[ENCRYPT_GCM_128]   = aes_bs_gcm_encrypt,
+	[ENCRYPT_GCM_192]   = aes_bs_gcm_encrypt,
+	[ENCRYPT_GCM_256]   = aes_bs_gcm_encrypt,
+	[DECRYPT_GCM_128]   = aes_bs_gcm_decrypt,
+	[DECRYPT_GCM_192]   = aes_bs_gcm_decrypt,
+	[DECRYPT_GCM_256]   = aes_bs_gcm_decrypt,
 	/* OCB */
 	[ENCRYPT_OCB_128]   = aes_generic_ocb_encrypt,
 	[ENCRYPT_OCB_192]   = aes_generic_ocb_encrypt,
@@ -128,16 +156,30 @@ void *branch_table[] = {
 	[DECRYPT_OCB_128]   = aes_generic_ocb_decrypt,
 	[DECRYPT_OCB_192]   = aes_generic_ocb_decrypt,
 	[DECRYPT_OCB_256]   = aes_generic_ocb_decrypt,
+	[AAD_OCB_128]       = aes_generic_ocb_aad,
+	[AAD_OCB_192]       = aes_generic_ocb_aad,
+	[AAD_OCB_256]       = aes_generic_ocb_aad,
+	/* GHASH */
+	[GHASH_INIT]        = gf_ghash_init,
+	[GHASH_MUL]         = gf_ghash_mul,
+	[GHASH_BLOCKS]      = gf_ghash_blocks,
 };
 
 typedef void (*init_f)(aes_key *, uint8_t *, uint8_t);
 typedef void (*ecb_f)(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks);
 typedef void (*cbc_f)(aes_block *output, aes_key *key, aes_block *iv, aes_block *input, uint32_t nb_blocks);
+typedef void (*cbcn_f)(aes_block **output, aes_key **keys, aes_block *ivs, aes_block **input, uint32_t nb_blocks);
 typedef void (*ctr_f)(uint8_t *output, aes_key *key, aes_block *iv, uint8_t *input, uint32_t length);
+typedef void (*gen_ctr_f)(aes_block *output, aes_key *key, aes_block *iv, uint32_t nb_blocks);
 typedef void (*xts_f)(aes_block *output, aes_key *k1, aes_key *k2, aes_block *dataunit, uint32_t spoint, aes_block *input, uint32_t nb_blocks);
 typedef void (*gcm_crypt_f)(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length);
 typedef void (*ocb_crypt_f)(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length);
+typedef void (*ocb_aad_f)(aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length);
 typedef void (*block_f)(aes_block *output, aes_key *key, aes_block *input);
+typedef void (*block8_f)(aes_block *output, aes_key **keys, aes_block *input);
+typedef void (*ghash_init_f)(block128 *htable, block128 *h);
+typedef void (*ghash_mul_f)(block128 *a, block128 *htable);
+typedef void (*ghash_blocks_f)(block128 *tag, block128 *htable, uint8_t *input, uint32_t nb_blocks);
 
 #ifdef WITH_AESNI
 #define GET_INIT(strength) \
@@ -150,8 +192,16 @@ typedef void (*block_f)(aes_block *output, aes_key *key, aes_block *input);
 	((cbc_f) (branch_table[ENCRYPT_CBC_128 + strength]))
 #define GET_CBC_DECRYPT(strength) \
 	((cbc_f) (branch_table[DECRYPT_CBC_128 + strength]))
+#define GET_BLOCK8_ENCRYPT(strength) \
+	((block8_f) (branch_table[ENCRYPT_BLOCK8_128 + strength]))
+#define GET_CBC4_ENCRYPT(strength) \
+	((cbcn_f) (branch_table[ENCRYPT_CBC4_128 + strength]))
+#define GET_CBC8_ENCRYPT(strength) \
+	((cbcn_f) (branch_table[ENCRYPT_CBC8_128 + strength]))
 #define GET_CTR_ENCRYPT(strength) \
 	((ctr_f) (branch_table[ENCRYPT_CTR_128 + strength]))
+#define GET_CTR_GEN(strength) \
+	((gen_ctr_f) (branch_table[GEN_CTR_128 + strength]))
 #define GET_XTS_ENCRYPT(strength) \
 	((xts_f) (branch_table[ENCRYPT_XTS_128 + strength]))
 #define GET_XTS_DECRYPT(strength) \
@@ -164,66 +214,217 @@ typedef void (*block_f)(aes_block *output, aes_key *key, aes_block *input);
 	((ocb_crypt_f) (branch_table[ENCRYPT_OCB_128 + strength]))
 #define GET_OCB_DECRYPT(strength) \
 	((ocb_crypt_f) (branch_table[DECRYPT_OCB_128 + strength]))
+#define GET_OCB_AAD(strength) \
+	((ocb_aad_f) (branch_table[AAD_OCB_128 + strength]))
 #define aes_encrypt_block(o,k,i) \
 	(((block_f) (branch_table[ENCRYPT_BLOCK_128 + k->strength]))(o,k,i))
 #define aes_decrypt_block(o,k,i) \
 	(((block_f) (branch_table[DECRYPT_BLOCK_128 + k->strength]))(o,k,i))
+#define gcm_ghash_init(t,h) \
+	(((ghash_init_f) (branch_table[GHASH_INIT]))(t,h))
+#define gcm_gf_mul(a,t) \
+	(((ghash_mul_f) (branch_table[GHASH_MUL]))(a,t))
+#define gcm_ghash_blocks(a,t,i,n) \
+	(((ghash_blocks_f) (branch_table[GHASH_BLOCKS]))(a,t,i,n))
 #else
-#define GET_INIT(strength) aes_generic_init
-#define GET_ECB_ENCRYPT(strength) aes_generic_encrypt_ecb
-#define GET_ECB_DECRYPT(strength) aes_generic_decrypt_ecb
+#define GET_INIT(strength) aes_bs_initkey
+#define GET_ECB_ENCRYPT(strength) aes_bs_encrypt_ecb
+#define GET_ECB_DECRYPT(strength) aes_bs_decrypt_ecb
 #define GET_CBC_ENCRYPT(strength) aes_generic_encrypt_cbc
-#define GET_CBC_DECRYPT(strength) aes_generic_decrypt_cbc
-#define GET_CTR_ENCRYPT(strength) aes_generic_encrypt_ctr
+#define GET_CBC_DECRYPT(strength) aes_bs_decrypt_cbc
+#define GET_BLOCK8_ENCRYPT(strength) block8_serial_encrypt
+#define GET_CBC4_ENCRYPT(strength) cbc4_serial_encrypt
+#define GET_CBC8_ENCRYPT(strength) cbc8_serial_encrypt
+#define GET_CTR_ENCRYPT(strength) aes_bs_encrypt_ctr
+#define GET_CTR_GEN(strength) gen_ctr_ecb
 #define GET_XTS_ENCRYPT(strength) aes_generic_encrypt_xts
 #define GET_XTS_DECRYPT(strength) aes_generic_decrypt_xts
-#define GET_GCM_ENCRYPT(strength) aes_generic_gcm_encrypt
-#define GET_GCM_DECRYPT(strength) aes_generic_gcm_decrypt
+#define GET_GCM_ENCRYPT(strength) aes_bs_gcm_encrypt
+#define GET_GCM_DECRYPT(strength) aes_bs_gcm_decrypt
 #define GET_OCB_ENCRYPT(strength) aes_generic_ocb_encrypt
 #define GET_OCB_DECRYPT(strength) aes_generic_ocb_decrypt
+#define GET_OCB_AAD(strength) aes_generic_ocb_aad
 #define aes_encrypt_block(o,k,i) aes_generic_encrypt_block(o,k,i)
 #define aes_decrypt_block(o,k,i) aes_generic_decrypt_block(o,k,i)
+#define gcm_ghash_init(t,h) gf_ghash_init(t,h)
+#define gcm_gf_mul(a,t) gf_ghash_mul(a,t)
+#define gcm_ghash_blocks(a,t,i,n) gf_ghash_blocks(a,t,i,n)
 #endif
 
 #if defined(ARCH_X86) && defined(WITH_AESNI)
-void initialize_table_ni(int aesni, int pclmul)
+/* vector permute implementation, for cpus with SSSE3 but without AES-NI.
+ * GCM and OCB go through the single block functions. */
+static void initialize_table_vp(void)
 {
-	if (!aesni)
+	branch_table[INIT_128] = aes_vp_init;
+	branch_table[INIT_192] = aes_vp_init;
+	branch_table[INIT_256] = aes_vp_init;
+
+	branch_table[ENCRYPT_BLOCK_128] = aes_vp_encrypt_block;
+	branch_table[ENCRYPT_BLOCK_192] = aes_vp_encrypt_block;
+	branch_table[ENCRYPT_BLOCK_256] = aes_vp_encrypt_block;
+	branch_table[DECRYPT_BLOCK_128] = aes_vp_decrypt_block;
+	branch_table[DECRYPT_BLOCK_192] = aes_vp_decrypt_block;
+	branch_table[DECRYPT_BLOCK_256] = aes_vp_decrypt_block;
+	/* ECB */
+	branch_table[ENCRYPT_ECB_128] = aes_vp_encrypt_ecb;
+	branch_table[ENCRYPT_ECB_192] = aes_vp_encrypt_ecb;
+	branch_table[ENCRYPT_ECB_256] = aes_vp_encrypt_ecb;
+	branch_table[DECRYPT_ECB_128] = aes_vp_decrypt_ecb;
+	branch_table[DECRYPT_ECB_192] = aes_vp_decrypt_ecb;
+	branch_table[DECRYPT_ECB_256] = aes_vp_decrypt_ecb;
+	/* CBC */
+	branch_table[ENCRYPT_CBC_128] = aes_vp_encrypt_cbc;
+	branch_table[ENCRYPT_CBC_192] = aes_vp_encrypt_cbc;
+	branch_table[ENCRYPT_CBC_256] = aes_vp_encrypt_cbc;
+	branch_table[DECRYPT_CBC_128] = aes_vp_decrypt_cbc;
+	branch_table[DECRYPT_CBC_192] = aes_vp_decrypt_cbc;
+	branch_table[DECRYPT_CBC_256] = aes_vp_decrypt_cbc;
+	/* CTR */
+	branch_table[ENCRYPT_CTR_128] = aes_vp_encrypt_ctr;
+	branch_table[ENCRYPT_CTR_192] = aes_vp_encrypt_ctr;
+	branch_table[ENCRYPT_CTR_256] = aes_vp_encrypt_ctr;
+	/* XTS */
+	branch_table[ENCRYPT_XTS_128] = aes_vp_encrypt_xts;
+	branch_table[ENCRYPT_XTS_192] = aes_vp_encrypt_xts;
+	branch_table[ENCRYPT_XTS_256] = aes_vp_encrypt_xts;
+	branch_table[DECRYPT_XTS_128] = aes_vp_decrypt_xts;
+	branch_table[DECRYPT_XTS_192] = aes_vp_decrypt_xts;
+	branch_table[DECRYPT_XTS_256] = aes_vp_decrypt_xts;
+	/* GCM */
+	branch_table[ENCRYPT_GCM_128] = aes_generic_gcm_encrypt;
+	branch_table[ENCRYPT_GCM_192] = aes_generic_gcm_encrypt;
+	branch_table[ENCRYPT_GCM_256] = aes_generic_gcm_encrypt;
+	branch_table[DECRYPT_GCM_128] = aes_generic_gcm_decrypt;
+	branch_table[DECRYPT_GCM_192] = aes_generic_gcm_decrypt;
+	branch_table[DECRYPT_GCM_256] = aes_generic_gcm_decrypt;
+}
+
+/* the default entries, saved before the first initialize_table_ni so that
+ * aes_force_implementation can start again from them */
+static void *branch_table_default[sizeof(branch_table) / sizeof(branch_table[0])];
+
+void initialize_table_ni(int aesni, int pclmul, int ssse3)
+{
+	static int saved = 0;
+
+	if (!saved) {
+		memcpy(branch_table_default, branch_table, sizeof(branch_table));
+		saved = 1;
+	} else
+		memcpy(branch_table, branch_table_default, sizeof(branch_table));
+
+	if (pclmul) {
+		branch_table[GHASH_INIT] = gf_ghash_init_x86ni;
+		branch_table[GHASH_MUL] = gf_ghash_mul_x86ni;
+		branch_table[GHASH_BLOCKS] = gf_ghash_blocks_x86ni;
+	}
+	if (!aesni) {
+		if (ssse3)
+			initialize_table_vp();
 		return;
+	}
 	branch_table[INIT_128] = aes_ni_init;
+	branch_table[INIT_192] = aes_ni_init;
 	branch_table[INIT_256] = aes_ni_init;
 
 	branch_table[ENCRYPT_BLOCK_128] = aes_ni_encrypt_block128;
 	branch_table[DECRYPT_BLOCK_128] = aes_ni_decrypt_block128;
+	branch_table[ENCRYPT_BLOCK_192] = aes_ni_encrypt_block192;
+	branch_table[DECRYPT_BLOCK_192] = aes_ni_decrypt_block192;
 	branch_table[ENCRYPT_BLOCK_256] = aes_ni_encrypt_block256;
 	branch_table[DECRYPT_BLOCK_256] = aes_ni_decrypt_block256;
+	branch_table[ENCRYPT_BLOCK8_128] = aes_ni_encrypt_block8128;
+	branch_table[ENCRYPT_BLOCK8_192] = aes_ni_encrypt_block8192;
+	branch_table[ENCRYPT_BLOCK8_256] = aes_ni_encrypt_block8256;
 	/* ECB */
 	branch_table[ENCRYPT_ECB_128] = aes_ni_encrypt_ecb128;
 	branch_table[DECRYPT_ECB_128] = aes_ni_decrypt_ecb128;
+	branch_table[ENCRYPT_ECB_192] = aes_ni_encrypt_ecb192;
+	branch_table[DECRYPT_ECB_192] = aes_ni_decrypt_ecb192;
 	branch_table[ENCRYPT_ECB_256] = aes_ni_encrypt_ecb256;
 	branch_table[DECRYPT_ECB_256] = aes_ni_decrypt_ecb256;
 	/* CBC */
 	branch_table[ENCRYPT_CBC_128] = aes_ni_encrypt_cbc128;
 	branch_table[DECRYPT_CBC_128] = aes_ni_decrypt_cbc128;
+	branch_table[ENCRYPT_CBC_192] = aes_ni_encrypt_cbc192;
+	branch_table[DECRYPT_CBC_192] = aes_ni_decrypt_cbc192;
 	branch_table[ENCRYPT_CBC_256] = aes_ni_encrypt_cbc256;
 	branch_table[DECRYPT_CBC_256] = aes_ni_decrypt_cbc256;
+	branch_table[ENCRYPT_CBC4_128] = aes_ni_encrypt_cbc4128;
+	branch_table[ENCRYPT_CBC4_192] = aes_ni_encrypt_cbc4192;
+	branch_table[ENCRYPT_CBC4_256] = aes_ni_encrypt_cbc4256;
+	branch_table[ENCRYPT_CBC8_128] = aes_ni_encrypt_cbc8128;
+	branch_table[ENCRYPT_CBC8_192] = aes_ni_encrypt_cbc8192;
+	branch_table[ENCRYPT_CBC8_256] = aes_ni_encrypt_cbc8256;
 	/* CTR */
 	branch_table[ENCRYPT_CTR_128] = aes_ni_encrypt_ctr128;
+	branch_table[ENCRYPT_CTR_192] = aes_ni_encrypt_ctr192;
 	branch_table[ENCRYPT_CTR_256] = aes_ni_encrypt_ctr256;
+	branch_table[GEN_CTR_128] = aes_ni_gen_ctr128;
+	branch_table[GEN_CTR_192] = aes_ni_gen_ctr192;
+	branch_table[GEN_CTR_256] = aes_ni_gen_ctr256;
 	/* XTS */
 	branch_table[ENCRYPT_XTS_128] = aes_ni_encrypt_xts128;
+	branch_table[ENCRYPT_XTS_192] = aes_ni_encrypt_xts192;
 	branch_table[ENCRYPT_XTS_256] = aes_ni_encrypt_xts256;
-	/* GCM */
-	branch_table[ENCRYPT_GCM_128] = aes_ni_gcm_encrypt128;
-	branch_table[ENCRYPT_GCM_256] = aes_ni_gcm_encrypt256;
+	branch_table[DECRYPT_XTS_128] = aes_ni_decrypt_xts128;
+	branch_table[DECRYPT_XTS_192] = aes_ni_decrypt_xts192;
+	branch_table[DECRYPT_XTS_256] = aes_ni_decrypt_xts256;
+	/* GCM: the NI kernels do their GHASH with pclmulqdq, otherwise the
+	 * generic code still benefits from the NI single block encryption */
+	if (pclmul) {
+		branch_table[ENCRYPT_GCM_128] = aes_ni_gcm_encrypt128;
+		branch_table[ENCRYPT_GCM_192] = aes_ni_gcm_encrypt192;
+		branch_table[ENCRYPT_GCM_256] = aes_ni_gcm_encrypt256;
+		branch_table[DECRYPT_GCM_128] = aes_ni_gcm_decrypt128;
+		branch_table[DECRYPT_GCM_192] = aes_ni_gcm_decrypt192;
+		branch_table[DECRYPT_GCM_256] = aes_ni_gcm_decrypt256;
+	} else {
+		branch_table[ENCRYPT_GCM_128] = aes_generic_gcm_encrypt;
+		branch_table[ENCRYPT_GCM_192] = aes_generic_gcm_encrypt;
+		branch_table[ENCRYPT_GCM_256] = aes_generic_gcm_encrypt;
+		branch_table[DECRYPT_GCM_128] = aes_generic_gcm_decrypt;
+		branch_table[DECRYPT_GCM_192] = aes_generic_gcm_decrypt;
+		branch_table[DECRYPT_GCM_256] = aes_generic_gcm_decrypt;
+	}
 	/* OCB */
-	/*
 	branch_table[ENCRYPT_OCB_128] = aes_ni_ocb_encrypt128;
+	branch_table[ENCRYPT_OCB_192] = aes_ni_ocb_encrypt192;
 	branch_table[ENCRYPT_OCB_256] = aes_ni_ocb_encrypt256;
-	*/
+	branch_table[DECRYPT_OCB_128] = aes_ni_ocb_decrypt128;
+	branch_table[DECRYPT_OCB_192] = aes_ni_ocb_decrypt192;
+	branch_table[DECRYPT_OCB_256] = aes_ni_ocb_decrypt256;
+	branch_table[AAD_OCB_128] = aes_ni_ocb_aad128;
+	branch_table[AAD_OCB_192] = aes_ni_ocb_aad192;
+	branch_table[AAD_OCB_256] = aes_ni_ocb_aad256;
 }
 #endif
 
+/* select the implementations as if the cpu only had the features that are
+ * requested, among the ones it has. for testing: contexts created before
+ * must not be used after. */
+void aes_force_implementation(int aesni, int pclmul, int ssse3)
+{
+#if defined(ARCH_X86) && defined(WITH_AESNI)
+	initialize_hw(initialize_table_ni);
+	initialize_hw_with(initialize_table_ni, aesni, pclmul, ssse3);
+#endif
+}
+
+/* bytes to allocate for the context of a key of size bytes. the software
+ * implementation keeps the bitsliced round keys after the aes_key, the
+ * other ones only need the aes_key. */
+uint32_t aes_key_size(uint8_t size)
+{
+#if defined(ARCH_X86) && defined(WITH_AESNI)
+	initialize_hw(initialize_table_ni);
+#endif
+	if (GET_INIT(0) == aes_bs_initkey)
+		return sizeof(aes_key) + AES_BS_KEY_SIZE(size);
+	return sizeof(aes_key);
+}
+
 void aes_initkey(aes_key *key, uint8_t *origkey, uint8_t size)
 {
 	switch (size) {
@@ -250,49 +451,236 @@ void aes_decrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t
 	d(output, key, input, nb_blocks);
 }
 
+/* no multi-key kernel: the blocks are done one after the other */
+static void block8_serial_encrypt(aes_block *output, aes_key **keys, aes_block *input)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		aes_encrypt_block(&output[i], keys[i], &input[i]);
+}
+
+/* encrypt the nb_blocks blocks of input, the i-th one with keys[i]. runs of 8
+ * blocks whose keys have the same size go through a multi-key kernel; a block
+ * starting a mixed run, and the last few blocks, are done one by one. */
+void aes_encrypt_blocks_many(aes_block *output, aes_key **keys, aes_block *input, uint32_t nb_blocks)
+{
+	uint32_t i = 0;
+	int strength, l;
+
+	while (i + 8 <= nb_blocks) {
+		strength = keys[i]->strength;
+		for (l = 1; l < 8; l++)
+			if (keys[i + l]->strength != strength)
+				break;
+		if (l == 8) {
+			GET_BLOCK8_ENCRYPT(strength)(&output[i], &keys[i], &input[i]);
+			i += 8;
+		} else {
+			aes_encrypt_block(&output[i], keys[i], &input[i]);
+			i++;
+		}
+	}
+	for (; i < nb_blocks; i++)
+		aes_encrypt_block(&output[i], keys[i], &input[i]);
+}
+
 void aes_encrypt_cbc(aes_block *output, aes_key *key, aes_block *iv, aes_block *input, uint32_t nb_blocks)
 {
 	cbc_f e = GET_CBC_ENCRYPT(key->strength);
 	e(output, key, iv, input, nb_blocks);
 }
 
+/* no multi-stream kernel: the streams are done one after the other */
+static void cbc_serial_encrypt(aes_block **output, aes_key **keys, aes_block *ivs, aes_block **input,
+                               uint32_t nb_blocks, int lanes)
+{
+	int i;
+
+	for (i = 0; i < lanes; i++) {
+		aes_encrypt_cbc(output[i], keys[i], &ivs[i], input[i], nb_blocks);
+		if (nb_blocks > 0)
+			block128_copy(&ivs[i], &output[i][nb_blocks - 1]);
+	}
+}
+
+static void cbc4_serial_encrypt(aes_block **output, aes_key **keys, aes_block *ivs, aes_block **input, uint32_t nb_blocks)
+{
+	cbc_serial_encrypt(output, keys, ivs, input, nb_blocks, 4);
+}
+
+static void cbc8_serial_encrypt(aes_block **output, aes_key **keys, aes_block *ivs, aes_block **input, uint32_t nb_blocks)
+{
+	cbc_serial_encrypt(output, keys, ivs, input, nb_blocks, 8);
+}
+
+/* encrypt nb_streams independent cbc streams, the i-th one being nb_blocks[i]
+ * blocks of inputs[i] with keys[i] and ivs[i]. streams using keys of the same
+ * size are grouped 8 (or 4) at a time and go through a multi-stream kernel for
+ * as many blocks as the shortest one, which is then replaced by the next stream
+ * of that size. the streams left when less than 4 remain are done serially. */
+void aes_encrypt_cbc_many(aes_block **outputs, aes_key **keys, aes_block **ivs, aes_block **inputs,
+                          uint32_t *nb_blocks, uint32_t nb_streams)
+{
+	aes_block *out[8], *in[8];
+	aes_key *k[8];
+	aes_block iv[8];
+	uint32_t left[8];
+	uint32_t next, n;
+	int strength, lanes, width, i, l;
+
+	for (strength = 0; strength < 3; strength++) {
+		next = 0;
+		lanes = 0;
+		for (;;) {
+			/* fill the free lanes with the next streams of this key size */
+			for (; lanes < 8 && next < nb_streams; next++) {
+				if (keys[next]->strength != strength || nb_blocks[next] == 0)
+					continue;
+				out[lanes] = outputs[next];
+				in[lanes] = inputs[next];
+				k[lanes] = keys[next];
+				block128_copy(&iv[lanes], ivs[next]);
+				left[lanes] = nb_blocks[next];
+				lanes++;
+			}
+			if (lanes < 4)
+				break;
+			width = (lanes == 8) ? 8 : 4;
+
+			n = left[0];
+			for (l = 1; l < width; l++)
+				if (left[l] < n)
+					n = left[l];
+			if (width == 8)
+				GET_CBC8_ENCRYPT(strength)(out, k, iv, in, n);
+			else
+				GET_CBC4_ENCRYPT(strength)(out, k, iv, in, n);
+
+			/* advance the lanes that were run, and compact away the finished ones */
+			for (l = 0, i = 0; l < lanes; l++) {
+				if (l < width) {
+					if (left[l] == n)
+						continue;
+					out[l] += n;
+					in[l] += n;
+					left[l] -= n;
+				}
+				out[i] = out[l];
+				in[i] = in[l];
+				k[i] = k[l];
+				block128_copy(&iv[i], &iv[l]);
+				left[i] = left[l];
+				i++;
+			}
+			lanes = i;
+		}
+		for (l = 0; l < lanes; l++)
+			aes_encrypt_cbc(out[l], k[l], &iv[l], in[l], left[l]);
+	}
+}
+
 void aes_decrypt_cbc(aes_block *output, aes_key *key, aes_block *iv, aes_block *input, uint32_t nb_blocks)
 {
 	cbc_f d = GET_CBC_DECRYPT(key->strength);
 	d(output, key, iv, input, nb_blocks);
 }
 
+/* write the counters to output and encrypt them in place with the ecb
+ * function of the key, which is bitsliced in the software implementation */
+static void gen_ctr_ecb(aes_block *output, aes_key *key, aes_block *iv, uint32_t nb_blocks)
+{
+	uint32_t i;
+
+	for (i = 0; i < nb_blocks; i++, block128_inc_be(iv))
+		block128_copy(&output[i], iv);
+	aes_encrypt_ecb(output, key, output, nb_blocks);
+}
+
 void aes_gen_ctr(aes_block *output, aes_key *key, const aes_block *iv, uint32_t nb_blocks)
 {
+	gen_ctr_f g = GET_CTR_GEN(key->strength);
 	aes_block block;
 
 	/* preload IV in block */
 	block128_copy(&block, iv);
-
-	for ( ; nb_blocks-- > 0; output++, block128_inc_be(&block)) {
-		aes_encrypt_block(output, key, &block);
-	}
+	g(output, key, &block, nb_blocks);
 }
 
 void aes_gen_ctr_cont(aes_block *output, aes_key *key, aes_block *iv, uint32_t nb_blocks)
 {
-	aes_block block;
+	gen_ctr_f g = GET_CTR_GEN(key->strength);
+	g(output, key, iv, nb_blocks);
+}
 
-	/* preload IV in block */
-	block128_copy(&block, iv);
+void aes_encrypt_ctr(uint8_t *output, aes_key *key, aes_block *iv, uint8_t *input, uint32_t len)
+{
+	ctr_f e = GET_CTR_ENCRYPT(key->strength);
+	e(output, key, iv, input, len);
+}
 
-	for ( ; nb_blocks-- > 0; output++, block128_inc_be(&block)) {
-		aes_encrypt_block(output, key, &block);
+/* encrypt length bytes of input as if they were at byte offset in the ctr
+ * stream of iv: the counter starts at iv + offset / 16, and the first
+ * offset % 16 bytes of its keystream block are skipped */
+void aes_encrypt_ctr_at(uint8_t *output, aes_key *key, aes_block *iv, uint64_t offset, uint8_t *input, uint32_t length)
+{
+	aes_block ctr, ks;
+	uint32_t skip = offset % 16, n, i;
+
+	block128_copy(&ctr, iv);
+	block128_add_be(&ctr, offset / 16);
+
+	if (skip > 0 && length > 0) {
+		aes_encrypt_block(&ks, key, &ctr);
+		block128_inc_be(&ctr);
+		n = (length < 16 - skip) ? length : 16 - skip;
+		for (i = 0; i < n; i++)
+			output[i] = input[i] ^ ks.b[skip + i];
+		output += n;
+		input += n;
+		length -= n;
 	}
+	if (length > 0)
+		aes_encrypt_ctr(output, key, &ctr, input, length);
+}
 
-	/* copy back the IV */
-	block128_copy(iv, &block);
+void aes_ctr_stream_init(aes_ctr_stream *st, aes_block *iv)
+{
+	block128_copy(&st->ctr, iv);
+	st->used = 16;
 }
 
-void aes_encrypt_ctr(uint8_t *output, aes_key *key, aes_block *iv, uint8_t *input, uint32_t len)
+/* continue the ctr stream for length bytes: first the unused end of the last
+ * keystream block, then whole blocks with the ctr kernel, and keep the
+ * keystream of a last partial block for the next call */
+void aes_ctr_stream_encrypt(uint8_t *output, aes_ctr_stream *st, aes_key *key, uint8_t *input, uint32_t length)
 {
-	ctr_f e = GET_CTR_ENCRYPT(key->strength);
-	e(output, key, iv, input, len);
+	uint32_t n, i;
+
+	n = (length < 16 - st->used) ? length : 16 - st->used;
+	for (i = 0; i < n; i++)
+		output[i] = input[i] ^ st->keystream.b[st->used + i];
+	st->used += n;
+	output += n;
+	input += n;
+	length -= n;
+
+	n = length & ~15;
+	if (n > 0) {
+		aes_encrypt_ctr(output, key, &st->ctr, input, n);
+		block128_add_be(&st->ctr, n / 16);
+		output += n;
+		input += n;
+		length -= n;
+	}
+
+	if (length > 0) {
+		aes_encrypt_block(&st->keystream, key, &st->ctr);
+		block128_inc_be(&st->ctr);
+		for (i = 0; i < length; i++)
+			output[i] = input[i] ^ st->keystream.b[i];
+		st->used = length;
+	}
 }
 
 void aes_encrypt_xts(aes_block *output, aes_key *k1, aes_key *k2, aes_block *dataunit,
@@ -305,7 +693,8 @@ void aes_encrypt_xts(aes_block *output, aes_key *k1, aes_key *k2, aes_block *dat
 void aes_decrypt_xts(aes_block *output, aes_key *k1, aes_key *k2, aes_block *dataunit,
                      uint32_t spoint, aes_block *input, uint32_t nb_blocks)
 {
-	aes_generic_decrypt_xts(output, k1, k2, dataunit, spoint, input, nb_blocks);
+	xts_f d = GET_XTS_DECRYPT(k1->strength);
+	d(output, k1, k2, dataunit, spoint, input, nb_blocks);
 }
 
 void aes_gcm_encrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length)
@@ -335,21 +724,18 @@ void aes_ocb_decrypt(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_t *input
 static void gcm_ghash_add(aes_gcm *gcm, block128 *b)
 {
 	block128_xor(&gcm->tag, b);
-	gf_mul(&gcm->tag, &gcm->h);
+	gcm_gf_mul(&gcm->tag, gcm->htable);
 }
 
-void aes_gcm_init(aes_gcm *gcm, aes_key *key, uint8_t *iv, uint32_t len)
+/* per message part of the initialization: H and its table are already set */
+static void gcm_init_iv(aes_gcm *gcm, uint8_t *iv, uint32_t len)
 {
 	gcm->length_aad = 0;
 	gcm->length_input = 0;
 
-	block128_zero(&gcm->h);
 	block128_zero(&gcm->tag);
 	block128_zero(&gcm->iv);
 
-	/* prepare H : encrypt_K(0^128) */
-	aes_encrypt_block(&gcm->h, key, &gcm->h);
-
 	if (len == 12) {
 		block128_copy_bytes(&gcm->iv, iv, 12);
 		gcm->iv.b[15] = 0x01;
@@ -358,26 +744,53 @@ void aes_gcm_init(aes_gcm *gcm, aes_key *key, uint8_t *iv, uint32_t len)
 		int i;
 		for (; len >= 16; len -= 16, iv += 16) {
 			block128_xor(&gcm->iv, (block128 *) iv);
-			gf_mul(&gcm->iv, &gcm->h);
+			gcm_gf_mul(&gcm->iv, gcm->htable);
 		}
 		if (len > 0) {
 			block128_xor_bytes(&gcm->iv, iv, len);
-			gf_mul(&gcm->iv, &gcm->h);
+			gcm_gf_mul(&gcm->iv, gcm->htable);
 		}
 		for (i = 15; origlen; --i, origlen >>= 8)
 			gcm->iv.b[i] ^= (uint8_t) origlen;
-		gf_mul(&gcm->iv, &gcm->h);
+		gcm_gf_mul(&gcm->iv, gcm->htable);
 	}
 
 	block128_copy(&gcm->civ, &gcm->iv);
 }
 
+void aes_gcm_init(aes_gcm *gcm, aes_key *key, uint8_t *iv, uint32_t len)
+{
+	/* prepare H : encrypt_K(0^128) */
+	block128_zero(&gcm->h);
+	aes_encrypt_block(&gcm->h, key, &gcm->h);
+	gcm_ghash_init(gcm->htable, &gcm->h);
+
+	gcm_init_iv(gcm, iv, len);
+}
+
+/* H and its table only depend on the key, so they can be computed once
+ * and then copied in each message context by aes_gcm_init_with */
+void aes_gcm_initkey(aes_gcm_key *gkey, aes_key *key)
+{
+	block128_zero(&gkey->h);
+	aes_encrypt_block(&gkey->h, key, &gkey->h);
+	gcm_ghash_init(gkey->htable, &gkey->h);
+}
+
+void aes_gcm_init_with(aes_gcm *gcm, aes_gcm_key *gkey, uint8_t *iv, uint32_t len)
+{
+	block128_copy(&gcm->h, &gkey->h);
+	memcpy(gcm->htable, gkey->htable, sizeof(gcm->htable));
+
+	gcm_init_iv(gcm, iv, len);
+}
+
 void aes_gcm_aad(aes_gcm *gcm, uint8_t *input, uint32_t length)
 {
 	gcm->length_aad += length;
-	for (; length >= 16; input += 16, length -= 16) {
-		gcm_ghash_add(gcm, (block128 *) input);
-	}
+	gcm_ghash_blocks(&gcm->tag, gcm->htable, input, length / 16);
+	input += length & ~15;
+	length %= 16;
 	if (length > 0) {
 		aes_block tmp;
 		block128_zero(&tmp);
@@ -387,7 +800,8 @@ void aes_gcm_aad(aes_gcm *gcm, uint8_t *input, uint32_t length)
 
 }
 
-void aes_gcm_finish(uint8_t *tag, aes_gcm *gcm, aes_key *key)
+/* finish the tag with mask = encrypt_K(iv) already computed */
+static void gcm_finish_mask(uint8_t *tag, aes_gcm *gcm, aes_block *mask)
 {
 	aes_block lblock;
 	int i;
@@ -397,38 +811,283 @@ void aes_gcm_finish(uint8_t *tag, aes_gcm *gcm, aes_key *key)
 	lblock.q[1] = cpu_to_be64(gcm->length_input << 3);
 	gcm_ghash_add(gcm, &lblock);
 
-	aes_encrypt_block(&lblock, key, &gcm->iv);
-	block128_xor(&gcm->tag, &lblock);
+	block128_xor(&gcm->tag, mask);
 
 	for (i = 0; i < 16; i++) {
 		tag[i] = gcm->tag.b[i];
 	}
 }
 
-static inline void ocb_block_double(block128 *d, block128 *s)
+void aes_gcm_finish(uint8_t *tag, aes_gcm *gcm, aes_key *key)
 {
-	unsigned int i;
-	uint8_t tmp = s->b[0];
+	aes_block mask;
 
-	for (i=0; i<15; i++)
-		d->b[i] = (s->b[i] << 1) | (s->b[i+1] >> 7);
-	d->b[15] = (s->b[15] << 1) ^ ((tmp >> 7) * 0x87);
+	aes_encrypt_block(&mask, key, &gcm->iv);
+	gcm_finish_mask(tag, gcm, &mask);
 }
 
-static void ocb_get_L_i(block128 *l, block128 *lis, unsigned int i)
+/* make part continue the message of gcm, skipping the next `blocks` full
+ * blocks, with an empty tag. disjoint chunks of the message can then be
+ * processed in parallel each in its own part, and merged back in order
+ * with aes_gcm_join, giving the same state as processing them serially. */
+void aes_gcm_fork(aes_gcm *part, aes_gcm *gcm, uint32_t blocks)
 {
-#define L_CACHED 4
-	i = bitfn_ntz(i);
-	if (i < L_CACHED) {
-		block128_copy(l, &lis[i]);
-	} else {
-		i -= (L_CACHED - 1);
-		block128_copy(l, &lis[L_CACHED - 1]);
-		while (i--) {
-			ocb_block_double(l, l);
+	memcpy(part, gcm, sizeof(aes_gcm));
+	block128_zero(&part->tag);
+	part->length_input = 0;
+	block128_add_be(&part->civ, blocks);
+}
+
+/* GHASH is linear: hashing the m blocks of part after gcm's tag is the
+ * same as tag * H^m xor the tag of part hashed from zero */
+void aes_gcm_join(aes_gcm *gcm, aes_gcm *part)
+{
+	block128 hm, sq;
+	uint64_t m = (part->length_input + 15) / 16;
+
+	/* hm = H^m, 1 being the leftmost bit in GHASH's order */
+	block128_zero(&hm);
+	hm.b[0] = 0x80;
+	block128_copy(&sq, &gcm->h);
+	for (; m > 0; m >>= 1) {
+		if (m & 1)
+			gf_mul(&hm, &sq);
+		gf_mul(&sq, &sq);
+	}
+	gf_mul(&gcm->tag, &hm);
+	block128_xor(&gcm->tag, &part->tag);
+
+	gcm->length_input += part->length_input;
+	block128_copy(&gcm->civ, &part->civ);
+}
+
+#define GCM_BATCH 8
+
+/* packets with at least that many bytes fill the 8-wide kernels on their
+ * own, and go through the stitched aes/ghash code one after the other */
+#define GCM_LONG (16 * GCM_BATCH)
+
+/* one of the short packets crypted side by side by gcm_crypt_lanes. the
+ * lanes have their own GHASH state but share the table of H. */
+typedef struct {
+	aes_block tag;
+	aes_block civ;
+	aes_block mask;
+	uint32_t packet;
+	uint32_t offset;
+	int masked;
+} gcm_lane;
+
+static void gcm_lane_ghash(gcm_lane *lane, aes_gcm *gcm, block128 *b)
+{
+	block128_xor(&lane->tag, b);
+	gcm_gf_mul(&lane->tag, gcm->htable);
+}
+
+/* crypt the short packets GCM_BATCH at a time: at each step the next
+ * block of every lane, either the iv for the tag mask of a new packet or
+ * its next counter block, is encrypted in the same aes_encrypt_ecb call,
+ * so the 8-wide kernels stay full even though no packet has 8 blocks.
+ * a lane is given the next short packet as soon as it is done. */
+static void gcm_crypt_lanes(uint8_t **outputs, uint8_t *tags, aes_gcm *gcm, aes_key *key,
+                            uint8_t **ivs, uint32_t *iv_lens, uint8_t **aads, uint32_t *aad_lens,
+                            uint8_t **inputs, uint32_t *lengths, uint32_t nb_packets, int encrypt)
+{
+	gcm_lane lanes[GCM_BATCH], *lane;
+	aes_block blocks[GCM_BATCH], tmp;
+	uint32_t next = 0, nb_lanes = 0, i, n, p;
+	uint8_t *input, *output;
+
+	for (;;) {
+		for (; nb_lanes < GCM_BATCH; next++) {
+			while (next < nb_packets && lengths[next] >= GCM_LONG)
+				next++;
+			if (next == nb_packets)
+				break;
+			lane = &lanes[nb_lanes++];
+			gcm_init_iv(gcm, ivs[next], iv_lens[next]);
+			aes_gcm_aad(gcm, aads[next], aad_lens[next]);
+			block128_copy(&lane->tag, &gcm->tag);
+			block128_copy(&lane->civ, &gcm->iv);
+			lane->packet = next;
+			lane->offset = 0;
+			lane->masked = 0;
+		}
+		if (nb_lanes == 0)
+			break;
+
+		for (i = 0; i < nb_lanes; i++) {
+			if (lanes[i].masked)
+				block128_inc_be(&lanes[i].civ);
+			block128_copy(&blocks[i], &lanes[i].civ);
+		}
+		aes_encrypt_ecb(blocks, key, blocks, nb_lanes);
+
+		for (i = 0; i < nb_lanes;) {
+			lane = &lanes[i];
+			p = lane->packet;
+			if (!lane->masked) {
+				block128_copy(&lane->mask, &blocks[i]);
+				lane->masked = 1;
+			} else {
+				input = inputs[p] + lane->offset;
+				output = outputs[p] + lane->offset;
+				n = lengths[p] - lane->offset;
+				if (n >= 16) {
+					n = 16;
+					if (encrypt) {
+						block128_vxor(&tmp, &blocks[i], (block128 *) input);
+						gcm_lane_ghash(lane, gcm, &tmp);
+						block128_copy((block128 *) output, &tmp);
+					} else {
+						gcm_lane_ghash(lane, gcm, (block128 *) input);
+						block128_vxor((block128 *) output, &blocks[i], (block128 *) input);
+					}
+				} else {
+					block128_zero(&tmp);
+					block128_copy_bytes(&tmp, input, n);
+					if (!encrypt)
+						gcm_lane_ghash(lane, gcm, &tmp);
+					block128_xor_bytes(&tmp, blocks[i].b, n);
+					if (encrypt)
+						gcm_lane_ghash(lane, gcm, &tmp);
+					memcpy(output, tmp.b, n);
+				}
+				lane->offset += n;
+			}
+
+			if (lane->masked && lane->offset == lengths[p]) {
+				block128_copy(&gcm->tag, &lane->tag);
+				gcm->length_aad = aad_lens[p];
+				gcm->length_input = lengths[p];
+				gcm_finish_mask(tags + 16 * p, gcm, &lane->mask);
+
+				/* the last lane takes its place, along with its block */
+				nb_lanes--;
+				lanes[i] = lanes[nb_lanes];
+				block128_copy(&blocks[i], &blocks[nb_lanes]);
+			} else
+				i++;
+		}
+	}
+	memory_zero(blocks, sizeof(blocks));
+	memory_zero(lanes, sizeof(lanes));
+}
+
+/* seal or open many packets under the same key in one call. the tables of
+ * gkey are only copied once for the whole call. the long packets go
+ * through the same stitched aes/ghash code as aes_gcm_encrypt and
+ * aes_gcm_decrypt, with the tag masks of 8 of them encrypted together;
+ * the short ones are interleaved by gcm_crypt_lanes. */
+static void gcm_crypt_many(uint8_t **outputs, uint8_t *tags, aes_gcm_key *gkey, aes_key *key,
+                           uint8_t **ivs, uint32_t *iv_lens, uint8_t **aads, uint32_t *aad_lens,
+                           uint8_t **inputs, uint32_t *lengths, uint32_t nb_packets, int encrypt)
+{
+	gcm_crypt_f f = encrypt ? GET_GCM_ENCRYPT(key->strength) : GET_GCM_DECRYPT(key->strength);
+	aes_gcm gcm;
+	aes_block j0[GCM_BATCH], mask[GCM_BATCH];
+	uint32_t packet[GCM_BATCH];
+	uint32_t i, j, nb, p;
+
+	block128_copy(&gcm.h, &gkey->h);
+	memcpy(gcm.htable, gkey->htable, sizeof(gcm.htable));
+
+	for (i = 0; i < nb_packets;) {
+		for (nb = 0; nb < GCM_BATCH && i < nb_packets; i++) {
+			if (lengths[i] < GCM_LONG)
+				continue;
+			gcm_init_iv(&gcm, ivs[i], iv_lens[i]);
+			block128_copy(&j0[nb], &gcm.iv);
+			packet[nb++] = i;
+		}
+		if (nb == 0)
+			break;
+		aes_encrypt_ecb(mask, key, j0, nb);
+
+		for (j = 0; j < nb; j++) {
+			p = packet[j];
+			gcm.length_aad = 0;
+			gcm.length_input = 0;
+			block128_zero(&gcm.tag);
+			block128_copy(&gcm.iv, &j0[j]);
+			block128_copy(&gcm.civ, &j0[j]);
+
+			aes_gcm_aad(&gcm, aads[p], aad_lens[p]);
+			f(outputs[p], &gcm, key, inputs[p], lengths[p]);
+			gcm_finish_mask(tags + 16 * p, &gcm, &mask[j]);
 		}
 	}
-#undef L_CACHED
+
+	gcm_crypt_lanes(outputs, tags, &gcm, key, ivs, iv_lens, aads, aad_lens,
+	                inputs, lengths, nb_packets, encrypt);
+}
+
+void aes_gcm_encrypt_many(uint8_t **outputs, uint8_t *tags, aes_gcm_key *gkey, aes_key *key,
+                          uint8_t **ivs, uint32_t *iv_lens, uint8_t **aads, uint32_t *aad_lens,
+                          uint8_t **inputs, uint32_t *lengths, uint32_t nb_packets)
+{
+	gcm_crypt_many(outputs, tags, gkey, key, ivs, iv_lens, aads, aad_lens, inputs, lengths, nb_packets, 1);
+}
+
+void aes_gcm_decrypt_many(uint8_t **outputs, uint8_t *tags, aes_gcm_key *gkey, aes_key *key,
+                          uint8_t **ivs, uint32_t *iv_lens, uint8_t **aads, uint32_t *aad_lens,
+                          uint8_t **inputs, uint32_t *lengths, uint32_t nb_packets)
+{
+	gcm_crypt_many(outputs, tags, gkey, key, ivs, iv_lens, aads, aad_lens, inputs, lengths, nb_packets, 0);
+}
+
+void aes_gmac_init(aes_gmac_ctx *gmac, aes_key *key, uint8_t *iv, uint32_t len)
+{
+	aes_gcm_init(&gmac->gcm, key, iv, len);
+	gmac->partial_len = 0;
+}
+
+/* same as aes_gcm_aad, except the input can be split anywhere: the bytes
+ * not making a full block are kept in the context until the next call */
+void aes_gmac_update(aes_gmac_ctx *gmac, uint8_t *input, uint32_t length)
+{
+	aes_gcm *gcm = &gmac->gcm;
+
+	gcm->length_aad += length;
+	if (gmac->partial_len > 0) {
+		uint32_t n = 16 - gmac->partial_len;
+		if (n > length)
+			n = length;
+		memcpy(gmac->partial.b + gmac->partial_len, input, n);
+		gmac->partial_len += n;
+		input += n;
+		length -= n;
+		if (gmac->partial_len < 16)
+			return;
+		gcm_ghash_add(gcm, &gmac->partial);
+		gmac->partial_len = 0;
+	}
+	gcm_ghash_blocks(&gcm->tag, gcm->htable, input, length / 16);
+	input += length & ~15;
+	length %= 16;
+	if (length > 0) {
+		memcpy(gmac->partial.b, input, length);
+		gmac->partial_len = length;
+	}
+}
+
+void aes_gmac_finish(uint8_t *tag, aes_gmac_ctx *gmac, aes_key *key)
+{
+	if (gmac->partial_len > 0) {
+		memset(gmac->partial.b + gmac->partial_len, 0, 16 - gmac->partial_len);
+		gcm_ghash_add(&gmac->gcm, &gmac->partial);
+		gmac->partial_len = 0;
+	}
+	aes_gcm_finish(tag, &gmac->gcm, key);
+}
+
+void aes_gmac(uint8_t *tag, aes_key *key, uint8_t *iv, uint32_t ivlen, uint8_t *input, uint32_t length)
+{
+	aes_gmac_ctx gmac;
+
+	aes_gmac_init(&gmac, key, iv, ivlen);
+	aes_gmac_update(&gmac, input, length);
+	aes_gmac_finish(tag, &gmac, key);
 }
 
 void aes_ocb_init(aes_ocb *ocb, aes_key *key, uint8_t *iv, uint32_t len)
@@ -480,32 +1139,58 @@ void aes_ocb_init(aes_ocb *ocb, aes_key *key, uint8_t *iv, uint32_t len)
 	block128_zero(&ocb->sum_aad);
 	block128_zero(&ocb->sum_enc);
 	block128_zero(&ocb->offset_aad);
+	ocb->blocks_aad = 0;
+	ocb->blocks_enc = 0;
 }
 
 void aes_ocb_aad(aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length)
 {
-	block128 tmp;
-	unsigned int i;
-
-	for (i=1; i<= length/16; i++, input=input+16) {
-		ocb_get_L_i(&tmp, ocb->li, i);
-		block128_xor(&ocb->offset_aad, &tmp);
+	ocb_aad_f a = GET_OCB_AAD(key->strength);
+	a(ocb, key, input, length);
+}
 
-		block128_vxor(&tmp, &ocb->offset_aad, (block128 *) input);
-		aes_encrypt_block(&tmp, key, &tmp);
-		block128_xor(&ocb->sum_aad, &tmp);
+/* xor of L_{ntz(j)} for j = 1 .. n: L_{ntz(j)} flips bit ntz(j) of the gray
+ * code of j, so this is the xor of the L_k for the bits k set in gray(n) */
+static void ocb_sum_L(block128 *sum, block128 *lis, uint32_t n)
+{
+	block128 l;
+	uint32_t gray = n ^ (n >> 1);
+	int k;
+
+	block128_zero(sum);
+	for (k = 0; gray; k++, gray >>= 1) {
+		if (gray & 1) {
+			ocb_get_L_i(&l, lis, 1U << k);
+			block128_xor(sum, &l);
+		}
 	}
+}
 
-	length = length % 16; /* Bytes in final block */
-	if (length > 0) {
-		block128_xor(&ocb->offset_aad, &ocb->lstar);
-		block128_zero(&tmp);
-		block128_copy_bytes(&tmp, input, length);
-		tmp.b[length] = 0x80;
-		block128_xor(&tmp, &ocb->offset_aad);
-		aes_encrypt_block(&tmp, key, &tmp);
-		block128_xor(&ocb->sum_aad, &tmp);
-	}
+/* make part continue the message of ocb, skipping the next `blocks` full
+ * blocks, with an empty checksum. disjoint chunks of the message can then
+ * be processed in parallel each in its own part, and merged back in order
+ * with aes_ocb_join, giving the same state as processing them serially. */
+void aes_ocb_fork(aes_ocb *part, aes_ocb *ocb, uint32_t blocks)
+{
+	block128 tmp;
+
+	memcpy(part, ocb, sizeof(aes_ocb));
+	block128_zero(&part->sum_enc);
+	if (blocks == 0)
+		return;
+	/* Offset_{a+b} = Offset_a xor sum(L, a) xor sum(L, a+b) */
+	ocb_sum_L(&tmp, ocb->li, ocb->blocks_enc);
+	block128_xor(&part->offset_enc, &tmp);
+	ocb_sum_L(&tmp, ocb->li, ocb->blocks_enc + blocks);
+	block128_xor(&part->offset_enc, &tmp);
+	part->blocks_enc += blocks;
+}
+
+void aes_ocb_join(aes_ocb *ocb, aes_ocb *part)
+{
+	block128_xor(&ocb->sum_enc, &part->sum_enc);
+	block128_copy(&ocb->offset_enc, &part->offset_enc);
+	ocb->blocks_enc = part->blocks_enc;
 }
 
 void aes_ocb_finish(uint8_t *tag, aes_ocb *ocb, aes_key *key)
@@ -593,9 +1278,7 @@ void aes_generic_encrypt_xts(aes_block *output, aes_key *k1, aes_key *k2, aes_bl
 	block128_copy(&tweak, dataunit);
 	aes_encrypt_block(&tweak, k2, &tweak);
 
-	/* TO OPTIMISE: this is really inefficient way to do that */
-	while (spoint-- > 0)
-		gf_mulx(&tweak);
+	gf_mulx_pow(&tweak, spoint);
 
 	for ( ; nb_blocks-- > 0; input++, output++, gf_mulx(&tweak)) {
 		block128_vxor(&block, input, &tweak);
@@ -613,9 +1296,7 @@ void aes_generic_decrypt_xts(aes_block *output, aes_key *k1, aes_key *k2, aes_bl
 	block128_copy(&tweak, dataunit);
 	aes_encrypt_block(&tweak, k2, &tweak);
 
-	/* TO OPTIMISE: this is really inefficient way to do that */
-	while (spoint-- > 0)
-		gf_mulx(&tweak);
+	gf_mulx_pow(&tweak, spoint);
 
 	for ( ; nb_blocks-- > 0; input++, output++, gf_mulx(&tweak)) {
 		block128_vxor(&block, input, &tweak);
@@ -689,14 +1370,72 @@ void aes_generic_gcm_decrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_
 	}
 }
 
+/* same as the generic GCM above, with the counter blocks encrypted
+ * AES_BS_BLOCKS at a time by the bitsliced implementation */
+static void gcm_bs_crypt(uint8_t *output, aes_gcm *gcm, aes_key *key,
+                         uint8_t *input, uint32_t length, int encrypt)
+{
+	aes_block ks[AES_BS_BLOCKS], tmp;
+	uint32_t i, n;
+
+	gcm->length_input += length;
+	while (length > 0) {
+		n = (length + 15) / 16;
+		if (n > AES_BS_BLOCKS)
+			n = AES_BS_BLOCKS;
+		for (i = 0; i < AES_BS_BLOCKS; i++) {
+			if (i < n) {
+				block128_inc_be(&gcm->civ);
+				block128_copy(&ks[i], &gcm->civ);
+			} else
+				block128_zero(&ks[i]);
+		}
+		aes_bs_encrypt_blocks(ks, key, ks);
+
+		for (i = 0; i < n && length >= 16; i++, input += 16, output += 16, length -= 16) {
+			if (encrypt) {
+				block128_vxor(&tmp, &ks[i], (block128 *) input);
+				gcm_ghash_add(gcm, &tmp);
+				block128_copy((block128 *) output, &tmp);
+			} else {
+				gcm_ghash_add(gcm, (block128 *) input);
+				block128_vxor((block128 *) output, &ks[i], (block128 *) input);
+			}
+		}
+		if (i < n) {
+			block128_zero(&tmp);
+			block128_copy_bytes(&tmp, input, length);
+			if (!encrypt)
+				gcm_ghash_add(gcm, &tmp);
+			block128_xor_bytes(&tmp, ks[i].b, length);
+			if (encrypt)
+				gcm_ghash_add(gcm, &tmp);
+			memcpy(output, tmp.b, length);
+			length = 0;
+		}
+	}
+	memory_zero(ks, sizeof(ks));
+}
+
+void aes_bs_gcm_encrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length)
+{
+	gcm_bs_crypt(output, gcm, key, input, length, 1);
+}
+
+void aes_bs_gcm_decrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length)
+{
+	gcm_bs_crypt(output, gcm, key, input, length, 0);
+}
+
 static void ocb_generic_crypt(uint8_t *output, aes_ocb *ocb, aes_key *key,
                               uint8_t *input, uint32_t length, int encrypt)
 {
 	block128 tmp, pad;
-	unsigned int i;
+	unsigned int i, nb_blocks;
 
-	for (i = 1; i <= length/16; i++, input += 16, output += 16) {
+	for (nb_blocks = length/16; nb_blocks > 0; nb_blocks--, input += 16, output += 16) {
 		/* Offset_i = Offset_{i-1} xor L_{ntz(i)} */
+		i = ++ocb->blocks_enc;
 		ocb_get_L_i(&tmp, ocb->li, i);
 		block128_xor(&ocb->offset_enc, &tmp);
 
@@ -747,3 +1486,30 @@ void aes_generic_ocb_decrypt(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_
 {
 	ocb_generic_crypt(output, ocb, key, input, length, 0);
 }
+
+void aes_generic_ocb_aad(aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length)
+{
+	block128 tmp;
+	unsigned int i, nb_blocks;
+
+	for (nb_blocks = length/16; nb_blocks > 0; nb_blocks--, input += 16) {
+		i = ++ocb->blocks_aad;
+		ocb_get_L_i(&tmp, ocb->li, i);
+		block128_xor(&ocb->offset_aad, &tmp);
+
+		block128_vxor(&tmp, &ocb->offset_aad, (block128 *) input);
+		aes_encrypt_block(&tmp, key, &tmp);
+		block128_xor(&ocb->sum_aad, &tmp);
+	}
+
+	length = length % 16; /* Bytes in final block */
+	if (length > 0) {
+		block128_xor(&ocb->offset_aad, &ocb->lstar);
+		block128_zero(&tmp);
+		block128_copy_bytes(&tmp, input, length);
+		tmp.b[length] = 0x80;
+		block128_xor(&tmp, &ocb->offset_aad);
+		aes_encrypt_block(&tmp, key, &tmp);
+		block128_xor(&ocb->sum_aad, &tmp);
+	}
+}
@@ -37,7 +37,8 @@
 
 typedef block128 aes_block;
 
-/* size = 456 */
+/* size = 456, followed by the bitsliced round keys with the software
+ * implementation, see aes_key_size */
 typedef struct {
 	uint8_t nbr; /* number of rounds: 10 (128), 12 (192), 14 (256) */
 	uint8_t strength; /* 128 = 0, 192 = 1, 256 = 2 */
@@ -45,7 +46,7 @@ typedef struct {
 	uint8_t data[16*14*2];
 } aes_key;
 
-/* size = 4*16+2*8= 80 */
+/* size = 4*16+2*8+16*16 = 336 */
 typedef struct {
 	aes_block tag;
 	aes_block h;
@@ -53,8 +54,23 @@ typedef struct {
 	aes_block civ;
 	uint64_t length_aad;
 	uint64_t length_input;
+	aes_block htable[16]; /* multiplication table for H, see gf_ghash_init, or powers of H with pclmulqdq */
 } aes_gcm;
 
+/* per key part of aes_gcm, size = 16+16*16 = 272 */
+typedef struct {
+	aes_block h;
+	aes_block htable[16];
+} aes_gcm_key;
+
+/* GCM with authentication only, size = 336+16+16 = 368 */
+typedef struct {
+	aes_gcm gcm;
+	aes_block partial; /* bytes not making a full block yet */
+	uint32_t partial_len;
+	uint8_t _padding[12];
+} aes_gmac_ctx;
+
 typedef struct {
 	block128 offset_aad;
 	block128 offset_enc;
@@ -63,22 +79,44 @@ typedef struct {
 	block128 lstar;
 	block128 ldollar;
 	block128 li[4];
+	uint32_t blocks_aad; /* number of full blocks processed so far */
+	uint32_t blocks_enc;
+	uint8_t _padding[8];
 } aes_ocb;
 
+/* ctr stream, size = 16+16+4+12 = 48 */
+typedef struct {
+	aes_block ctr; /* counter of the next keystream block */
+	aes_block keystream; /* last keystream block generated */
+	uint32_t used; /* bytes of keystream already used, 16 when none are left */
+	uint8_t _padding[12];
+} aes_ctr_stream;
+
+/* for testing: only use the given cpu features, when available */
+void aes_force_implementation(int aesni, int pclmul, int ssse3);
+
 /* in bytes: either 16,24,32 */
+uint32_t aes_key_size(uint8_t size);
 void aes_initkey(aes_key *ctx, uint8_t *key, uint8_t size);
 
 void aes_encrypt(aes_block *output, aes_key *key, aes_block *input);
 void aes_decrypt(aes_block *output, aes_key *key, aes_block *input);
 
+void aes_encrypt_blocks_many(aes_block *output, aes_key **keys, aes_block *input, uint32_t nb_blocks);
 void aes_encrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks);
 void aes_decrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks);
 
 void aes_encrypt_cbc(aes_block *output, aes_key *key, aes_block *iv, aes_block *input, uint32_t nb_blocks);
 void aes_decrypt_cbc(aes_block *output, aes_key *key, aes_block *iv, aes_block *input, uint32_t nb_blocks);
+void aes_encrypt_cbc_many(aes_block **outputs, aes_key **keys, aes_block **ivs, aes_block **inputs,
+                          uint32_t *nb_blocks, uint32_t nb_streams);
 
 void aes_gen_ctr(aes_block *output, aes_key *key, const aes_block *iv, uint32_t nb_blocks);
 void aes_gen_ctr_cont(aes_block *output, aes_key *key, aes_block *iv, uint32_t nb_blocks);
+void aes_encrypt_ctr(uint8_t *output, aes_key *key, aes_block *iv, uint8_t *input, uint32_t length);
+void aes_encrypt_ctr_at(uint8_t *output, aes_key *key, aes_block *iv, uint64_t offset, uint8_t *input, uint32_t length);
+void aes_ctr_stream_init(aes_ctr_stream *st, aes_block *iv);
+void aes_ctr_stream_encrypt(uint8_t *output, aes_ctr_stream *st, aes_key *key, uint8_t *input, uint32_t length);
 
 void aes_encrypt_xts(aes_block *output, aes_key *key, aes_key *key2, aes_block *sector,
                      uint32_t spoint, aes_block *input, uint32_t nb_blocks);
@@ -86,15 +124,32 @@ void aes_decrypt_xts(aes_block *output, aes_key *key, aes_key *key2, aes_block *
                      uint32_t spoint, aes_block *input, uint32_t nb_blocks);
 
 void aes_gcm_init(aes_gcm *gcm, aes_key *key, uint8_t *iv, uint32_t len);
+void aes_gcm_initkey(aes_gcm_key *gkey, aes_key *key);
+void aes_gcm_init_with(aes_gcm *gcm, aes_gcm_key *gkey, uint8_t *iv, uint32_t len);
 void aes_gcm_aad(aes_gcm *gcm, uint8_t *input, uint32_t length);
 void aes_gcm_encrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length);
 void aes_gcm_decrypt(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length);
 void aes_gcm_finish(uint8_t *tag, aes_gcm *gcm, aes_key *key);
+void aes_gcm_fork(aes_gcm *part, aes_gcm *gcm, uint32_t blocks);
+void aes_gcm_join(aes_gcm *gcm, aes_gcm *part);
+void aes_gcm_encrypt_many(uint8_t **outputs, uint8_t *tags, aes_gcm_key *gkey, aes_key *key,
+                          uint8_t **ivs, uint32_t *iv_lens, uint8_t **aads, uint32_t *aad_lens,
+                          uint8_t **inputs, uint32_t *lengths, uint32_t nb_packets);
+void aes_gcm_decrypt_many(uint8_t **outputs, uint8_t *tags, aes_gcm_key *gkey, aes_key *key,
+                          uint8_t **ivs, uint32_t *iv_lens, uint8_t **aads, uint32_t *aad_lens,
+                          uint8_t **inputs, uint32_t *lengths, uint32_t nb_packets);
+
+void aes_gmac_init(aes_gmac_ctx *gmac, aes_key *key, uint8_t *iv, uint32_t len);
+void aes_gmac_update(aes_gmac_ctx *gmac, uint8_t *input, uint32_t length);
+void aes_gmac_finish(uint8_t *tag, aes_gmac_ctx *gmac, aes_key *key);
+void aes_gmac(uint8_t *tag, aes_key *key, uint8_t *iv, uint32_t ivlen, uint8_t *input, uint32_t length);
 
 void aes_ocb_init(aes_ocb *ocb, aes_key *key, uint8_t *iv, uint32_t len);
 void aes_ocb_aad(aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length);
 void aes_ocb_encrypt(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length);
 void aes_ocb_decrypt(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length);
 void aes_ocb_finish(uint8_t *tag, aes_ocb *ocb, aes_key *key);
+void aes_ocb_fork(aes_ocb *part, aes_ocb *ocb, uint32_t blocks);
+void aes_ocb_join(aes_ocb *ocb, aes_ocb *part);
 
 #endif
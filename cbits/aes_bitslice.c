@@ -0,0 +1,558 @@
+/*
+ * Copyright (c) 2014 Vincent Hanquez <vincent@snarc.org>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of his contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * AES bitsliced implementation
+ *
+ * Four blocks are spread over eight 64-bit words so that word i holds bit i
+ * of every byte of the four states; with SSE2 each word carries two such
+ * lanes, and eight blocks are processed at once. The S-box is then
+ * computed as a boolean circuit (Boyar and Peralta) and ShiftRows/MixColumns
+ * become shifts and rotations of those words, so there are no secret
+ * dependent memory accesses or branches. The layout follows the "ct64"
+ * implementation of BearSSL.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "aes.h"
+#include "aes_bitslice.h"
+#include "aes_generic.h"
+#include "bitfn.h"
+#include "block128.h"
+
+static void bs_sbox(bs_word *q)
+{
+	bs_word x0, x1, x2, x3, x4, x5, x6, x7;
+	bs_word y1, y2, y3, y4, y5, y6, y7, y8, y9;
+	bs_word y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+	bs_word y20, y21;
+	bs_word z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+	bs_word z10, z11, z12, z13, z14, z15, z16, z17;
+	bs_word t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+	bs_word t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+	bs_word t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+	bs_word t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+	bs_word t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+	bs_word t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+	bs_word t60, t61, t62, t63, t64, t65, t66, t67;
+	bs_word s0, s1, s2, s3, s4, s5, s6, s7;
+
+	x0 = q[7]; x1 = q[6]; x2 = q[5]; x3 = q[4];
+	x4 = q[3]; x5 = q[2]; x6 = q[1]; x7 = q[0];
+
+	/* top linear transformation */
+	y14 = x3 ^ x5;
+	y13 = x0 ^ x6;
+	y9 = x0 ^ x3;
+	y8 = x0 ^ x5;
+	t0 = x1 ^ x2;
+	y1 = t0 ^ x7;
+	y4 = y1 ^ x3;
+	y12 = y13 ^ y14;
+	y2 = y1 ^ x0;
+	y5 = y1 ^ x6;
+	y3 = y5 ^ y8;
+	t1 = x4 ^ y12;
+	y15 = t1 ^ x5;
+	y20 = t1 ^ x1;
+	y6 = y15 ^ x7;
+	y10 = y15 ^ t0;
+	y11 = y20 ^ y9;
+	y7 = x7 ^ y11;
+	y17 = y10 ^ y11;
+	y19 = y10 ^ y8;
+	y16 = t0 ^ y11;
+	y21 = y13 ^ y16;
+	y18 = x0 ^ y16;
+
+	/* non-linear section */
+	t2 = y12 & y15;
+	t3 = y3 & y6;
+	t4 = t3 ^ t2;
+	t5 = y4 & x7;
+	t6 = t5 ^ t2;
+	t7 = y13 & y16;
+	t8 = y5 & y1;
+	t9 = t8 ^ t7;
+	t10 = y2 & y7;
+	t11 = t10 ^ t7;
+	t12 = y9 & y11;
+	t13 = y14 & y17;
+	t14 = t13 ^ t12;
+	t15 = y8 & y10;
+	t16 = t15 ^ t12;
+	t17 = t4 ^ t14;
+	t18 = t6 ^ t16;
+	t19 = t9 ^ t14;
+	t20 = t11 ^ t16;
+	t21 = t17 ^ y20;
+	t22 = t18 ^ y19;
+	t23 = t19 ^ y21;
+	t24 = t20 ^ y18;
+
+	t25 = t21 ^ t22;
+	t26 = t21 & t23;
+	t27 = t24 ^ t26;
+	t28 = t25 & t27;
+	t29 = t28 ^ t22;
+	t30 = t23 ^ t24;
+	t31 = t22 ^ t26;
+	t32 = t31 & t30;
+	t33 = t32 ^ t24;
+	t34 = t23 ^ t33;
+	t35 = t27 ^ t33;
+	t36 = t24 & t35;
+	t37 = t36 ^ t34;
+	t38 = t27 ^ t36;
+	t39 = t29 & t38;
+	t40 = t25 ^ t39;
+
+	t41 = t40 ^ t37;
+	t42 = t29 ^ t33;
+	t43 = t29 ^ t40;
+	t44 = t33 ^ t37;
+	t45 = t42 ^ t41;
+	z0 = t44 & y15;
+	z1 = t37 & y6;
+	z2 = t33 & x7;
+	z3 = t43 & y16;
+	z4 = t40 & y1;
+	z5 = t29 & y7;
+	z6 = t42 & y11;
+	z7 = t45 & y17;
+	z8 = t41 & y10;
+	z9 = t44 & y12;
+	z10 = t37 & y3;
+	z11 = t33 & y4;
+	z12 = t43 & y13;
+	z13 = t40 & y5;
+	z14 = t29 & y2;
+	z15 = t42 & y9;
+	z16 = t45 & y14;
+	z17 = t41 & y8;
+
+	/* bottom linear transformation */
+	t46 = z15 ^ z16;
+	t47 = z10 ^ z11;
+	t48 = z5 ^ z13;
+	t49 = z9 ^ z10;
+	t50 = z2 ^ z12;
+	t51 = z2 ^ z5;
+	t52 = z7 ^ z8;
+	t53 = z0 ^ z3;
+	t54 = z6 ^ z7;
+	t55 = z16 ^ z17;
+	t56 = z12 ^ t48;
+	t57 = t50 ^ t53;
+	t58 = z4 ^ t46;
+	t59 = z3 ^ t54;
+	t60 = t46 ^ t57;
+	t61 = z14 ^ t57;
+	t62 = t52 ^ t58;
+	t63 = t49 ^ t58;
+	t64 = z4 ^ t59;
+	t65 = t61 ^ t62;
+	t66 = z1 ^ t63;
+	s0 = t59 ^ t63;
+	s6 = t56 ^ ~t62;
+	s7 = t48 ^ ~t60;
+	t67 = t64 ^ t65;
+	s3 = t53 ^ t66;
+	s4 = t51 ^ t66;
+	s5 = t47 ^ t65;
+	s1 = t64 ^ ~s3;
+	s2 = t55 ^ ~t67;
+
+	q[7] = s0; q[6] = s1; q[5] = s2; q[4] = s3;
+	q[3] = s4; q[2] = s5; q[1] = s6; q[0] = s7;
+}
+
+/* the inverse affine transform of the S-box, applied around the forward
+ * circuit: InvSubBytes(x) = A^-1(S(A^-1(x))) */
+#define BS_INV_AFFINE(q) do { \
+	bs_word q0 = ~(q)[0], q1 = ~(q)[1], q2 = (q)[2], q3 = (q)[3]; \
+	bs_word q4 = (q)[4], q5 = ~(q)[5], q6 = ~(q)[6], q7 = (q)[7]; \
+	(q)[7] = q1 ^ q4 ^ q6; \
+	(q)[6] = q0 ^ q3 ^ q5; \
+	(q)[5] = q7 ^ q2 ^ q4; \
+	(q)[4] = q6 ^ q1 ^ q3; \
+	(q)[3] = q5 ^ q0 ^ q2; \
+	(q)[2] = q4 ^ q7 ^ q1; \
+	(q)[1] = q3 ^ q6 ^ q0; \
+	(q)[0] = q2 ^ q5 ^ q7; \
+	} while (0)
+
+static void bs_inv_sbox(bs_word *q)
+{
+	BS_INV_AFFINE(q);
+	bs_sbox(q);
+	BS_INV_AFFINE(q);
+}
+
+#define SWAPN(cl, ch, s, x, y) do { \
+	bs_word a = (x), b = (y); \
+	(x) = (a & (uint64_t) cl) | ((b & (uint64_t) cl) << (s)); \
+	(y) = ((a & (uint64_t) ch) >> (s)) | (b & (uint64_t) ch); \
+	} while (0)
+
+#define SWAP2(x, y) SWAPN(0x5555555555555555ULL, 0xAAAAAAAAAAAAAAAAULL, 1, x, y)
+#define SWAP4(x, y) SWAPN(0x3333333333333333ULL, 0xCCCCCCCCCCCCCCCCULL, 2, x, y)
+#define SWAP8(x, y) SWAPN(0x0F0F0F0F0F0F0F0FULL, 0xF0F0F0F0F0F0F0F0ULL, 4, x, y)
+
+/* transpose between "bytes in words" and "bit planes"; it's an involution */
+static void bs_ortho(bs_word *q)
+{
+	SWAP2(q[0], q[1]); SWAP2(q[2], q[3]); SWAP2(q[4], q[5]); SWAP2(q[6], q[7]);
+	SWAP4(q[0], q[2]); SWAP4(q[1], q[3]); SWAP4(q[4], q[6]); SWAP4(q[5], q[7]);
+	SWAP8(q[0], q[4]); SWAP8(q[1], q[5]); SWAP8(q[2], q[6]); SWAP8(q[3], q[7]);
+}
+
+#define load_le32(p) \
+	((uint32_t) (p)[0] | ((uint32_t) (p)[1] << 8) | ((uint32_t) (p)[2] << 16) | ((uint32_t) (p)[3] << 24))
+
+#define store_le32(p, v) do { \
+	(p)[0] = (uint8_t) (v); (p)[1] = (uint8_t) ((v) >> 8); \
+	(p)[2] = (uint8_t) ((v) >> 16); (p)[3] = (uint8_t) ((v) >> 24); \
+	} while (0)
+
+/* spread the 16 bytes of a block over two words, even columns in q0 and odd
+ * columns in q1 */
+static void bs_interleave_in(uint64_t *q0, uint64_t *q1, const uint8_t *b)
+{
+	uint64_t x0, x1, x2, x3;
+
+	x0 = load_le32(b + 0);
+	x1 = load_le32(b + 4);
+	x2 = load_le32(b + 8);
+	x3 = load_le32(b + 12);
+	x0 |= (x0 << 16);
+	x1 |= (x1 << 16);
+	x2 |= (x2 << 16);
+	x3 |= (x3 << 16);
+	x0 &= 0x0000FFFF0000FFFFULL;
+	x1 &= 0x0000FFFF0000FFFFULL;
+	x2 &= 0x0000FFFF0000FFFFULL;
+	x3 &= 0x0000FFFF0000FFFFULL;
+	x0 |= (x0 << 8);
+	x1 |= (x1 << 8);
+	x2 |= (x2 << 8);
+	x3 |= (x3 << 8);
+	x0 &= 0x00FF00FF00FF00FFULL;
+	x1 &= 0x00FF00FF00FF00FFULL;
+	x2 &= 0x00FF00FF00FF00FFULL;
+	x3 &= 0x00FF00FF00FF00FFULL;
+	*q0 = x0 | (x2 << 8);
+	*q1 = x1 | (x3 << 8);
+}
+
+static void bs_interleave_out(uint8_t *b, uint64_t q0, uint64_t q1)
+{
+	uint64_t x0, x1, x2, x3;
+
+	x0 = q0 & 0x00FF00FF00FF00FFULL;
+	x1 = q1 & 0x00FF00FF00FF00FFULL;
+	x2 = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+	x3 = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+	x0 |= (x0 >> 8);
+	x1 |= (x1 >> 8);
+	x2 |= (x2 >> 8);
+	x3 |= (x3 >> 8);
+	x0 &= 0x0000FFFF0000FFFFULL;
+	x1 &= 0x0000FFFF0000FFFFULL;
+	x2 &= 0x0000FFFF0000FFFFULL;
+	x3 &= 0x0000FFFF0000FFFFULL;
+	store_le32(b + 0, (uint32_t) x0 | (uint32_t) (x0 >> 16));
+	store_le32(b + 4, (uint32_t) x1 | (uint32_t) (x1 >> 16));
+	store_le32(b + 8, (uint32_t) x2 | (uint32_t) (x2 >> 16));
+	store_le32(b + 12, (uint32_t) x3 | (uint32_t) (x3 >> 16));
+}
+
+static inline void bs_add_round_key(bs_word *q, const bs_key_word *sk)
+{
+	q[0] ^= sk[0]; q[1] ^= sk[1]; q[2] ^= sk[2]; q[3] ^= sk[3];
+	q[4] ^= sk[4]; q[5] ^= sk[5]; q[6] ^= sk[6]; q[7] ^= sk[7];
+}
+
+static inline void bs_shift_rows(bs_word *q)
+{
+	int i;
+	for (i = 0; i < 8; i++) {
+		bs_word x = q[i];
+		q[i] = (x & 0x000000000000FFFFULL)
+		     | ((x & 0x00000000FFF00000ULL) >> 4)
+		     | ((x & 0x00000000000F0000ULL) << 12)
+		     | ((x & 0x0000FF0000000000ULL) >> 8)
+		     | ((x & 0x000000FF00000000ULL) << 8)
+		     | ((x & 0xF000000000000000ULL) >> 12)
+		     | ((x & 0x0FFF000000000000ULL) << 4);
+	}
+}
+
+static inline void bs_inv_shift_rows(bs_word *q)
+{
+	int i;
+	for (i = 0; i < 8; i++) {
+		bs_word x = q[i];
+		q[i] = (x & 0x000000000000FFFFULL)
+		     | ((x & 0x000000000FFF0000ULL) << 4)
+		     | ((x & 0x00000000F0000000ULL) >> 12)
+		     | ((x & 0x000000FF00000000ULL) << 8)
+		     | ((x & 0x0000FF0000000000ULL) >> 8)
+		     | ((x & 0x000F000000000000ULL) << 12)
+		     | ((x & 0xFFF0000000000000ULL) >> 4);
+	}
+}
+
+static inline bs_word rotr32(bs_word x)
+{
+	return (x << 32) | (x >> 32);
+}
+
+static inline void bs_mix_columns(bs_word *q)
+{
+	bs_word q0, q1, q2, q3, q4, q5, q6, q7;
+	bs_word r0, r1, r2, r3, r4, r5, r6, r7;
+
+	q0 = q[0]; q1 = q[1]; q2 = q[2]; q3 = q[3];
+	q4 = q[4]; q5 = q[5]; q6 = q[6]; q7 = q[7];
+	r0 = (q0 >> 16) | (q0 << 48);
+	r1 = (q1 >> 16) | (q1 << 48);
+	r2 = (q2 >> 16) | (q2 << 48);
+	r3 = (q3 >> 16) | (q3 << 48);
+	r4 = (q4 >> 16) | (q4 << 48);
+	r5 = (q5 >> 16) | (q5 << 48);
+	r6 = (q6 >> 16) | (q6 << 48);
+	r7 = (q7 >> 16) | (q7 << 48);
+
+	q[0] = q7 ^ r7 ^ r0 ^ rotr32(q0 ^ r0);
+	q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ rotr32(q1 ^ r1);
+	q[2] = q1 ^ r1 ^ r2 ^ rotr32(q2 ^ r2);
+	q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ rotr32(q3 ^ r3);
+	q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ rotr32(q4 ^ r4);
+	q[5] = q4 ^ r4 ^ r5 ^ rotr32(q5 ^ r5);
+	q[6] = q5 ^ r5 ^ r6 ^ rotr32(q6 ^ r6);
+	q[7] = q6 ^ r6 ^ r7 ^ rotr32(q7 ^ r7);
+}
+
+static inline void bs_inv_mix_columns(bs_word *q)
+{
+	bs_word q0, q1, q2, q3, q4, q5, q6, q7;
+	bs_word r0, r1, r2, r3, r4, r5, r6, r7;
+
+	q0 = q[0]; q1 = q[1]; q2 = q[2]; q3 = q[3];
+	q4 = q[4]; q5 = q[5]; q6 = q[6]; q7 = q[7];
+	r0 = (q0 >> 16) | (q0 << 48);
+	r1 = (q1 >> 16) | (q1 << 48);
+	r2 = (q2 >> 16) | (q2 << 48);
+	r3 = (q3 >> 16) | (q3 << 48);
+	r4 = (q4 >> 16) | (q4 << 48);
+	r5 = (q5 >> 16) | (q5 << 48);
+	r6 = (q6 >> 16) | (q6 << 48);
+	r7 = (q7 >> 16) | (q7 << 48);
+
+	q[0] = q5 ^ q6 ^ q7 ^ r0 ^ r5 ^ r7 ^ rotr32(q0 ^ q5 ^ q6 ^ r0 ^ r5);
+	q[1] = q0 ^ q5 ^ r0 ^ r1 ^ r5 ^ r6 ^ r7 ^ rotr32(q1 ^ q5 ^ q7 ^ r1 ^ r5 ^ r6);
+	q[2] = q0 ^ q1 ^ q6 ^ r1 ^ r2 ^ r6 ^ r7 ^ rotr32(q0 ^ q2 ^ q6 ^ r2 ^ r6 ^ r7);
+	q[3] = q0 ^ q1 ^ q2 ^ q5 ^ q6 ^ r0 ^ r2 ^ r3 ^ r5
+	     ^ rotr32(q0 ^ q1 ^ q3 ^ q5 ^ q6 ^ q7 ^ r0 ^ r3 ^ r5 ^ r7);
+	q[4] = q1 ^ q2 ^ q3 ^ q5 ^ r1 ^ r3 ^ r4 ^ r5 ^ r6 ^ r7
+	     ^ rotr32(q1 ^ q2 ^ q4 ^ q5 ^ q7 ^ r1 ^ r4 ^ r5 ^ r6);
+	q[5] = q2 ^ q3 ^ q4 ^ q6 ^ r2 ^ r4 ^ r5 ^ r6 ^ r7
+	     ^ rotr32(q2 ^ q3 ^ q5 ^ q6 ^ r2 ^ r5 ^ r6 ^ r7);
+	q[6] = q3 ^ q4 ^ q5 ^ q7 ^ r3 ^ r5 ^ r6 ^ r7
+	     ^ rotr32(q3 ^ q4 ^ q6 ^ q7 ^ r3 ^ r6 ^ r7);
+	q[7] = q4 ^ q5 ^ q6 ^ r4 ^ r6 ^ r7 ^ rotr32(q4 ^ q5 ^ q7 ^ r4 ^ r7);
+}
+
+#if AES_BS_LANES == 2
+#define BS_WORD(l0, l1) ((bs_word) { (l0), (l1) })
+#define BS_LANE(x, l) ((x)[l])
+#else
+#define BS_WORD(l0, l1) (l0)
+#define BS_LANE(x, l) (x)
+#endif
+
+/* expand the key with the generic implementation, then derive the
+ * bitsliced round keys from the encryption round keys at the start of
+ * key->data, by slicing 4 copies of each round key. this is done once per
+ * key, so the ecb, cbc, ctr and gcm functions start encrypting right away. */
+void aes_bs_initkey(aes_key *key, uint8_t *origkey, uint8_t size)
+{
+	bs_key_word *sk = AES_BS_KEY(key);
+	bs_word q[8];
+	uint64_t w0, w1;
+	int r, i;
+
+	aes_generic_init(key, origkey, size);
+	for (r = 0; r <= key->nbr; r++) {
+		bs_interleave_in(&w0, &w1, key->data + 16 * r);
+		q[0] = q[1] = q[2] = q[3] = BS_WORD(w0, w0);
+		q[4] = q[5] = q[6] = q[7] = BS_WORD(w1, w1);
+		bs_ortho(q);
+		for (i = 0; i < 8; i++)
+			sk[8 * r + i] = q[i];
+	}
+	memory_zero(q, sizeof(q));
+}
+
+static void bs_load(bs_word *q, aes_block *input)
+{
+	uint64_t w[AES_BS_LANES][8];
+	int i, l;
+
+	for (l = 0; l < AES_BS_LANES; l++)
+		for (i = 0; i < 4; i++)
+			bs_interleave_in(&w[l][i], &w[l][i + 4], input[4 * l + i].b);
+	for (i = 0; i < 8; i++)
+		q[i] = BS_WORD(w[0][i], w[AES_BS_LANES - 1][i]);
+	bs_ortho(q);
+}
+
+static void bs_store(aes_block *output, bs_word *q)
+{
+	int i, l;
+
+	bs_ortho(q);
+	for (l = 0; l < AES_BS_LANES; l++)
+		for (i = 0; i < 4; i++)
+			bs_interleave_out(output[4 * l + i].b, BS_LANE(q[i], l), BS_LANE(q[i + 4], l));
+}
+
+void aes_bs_encrypt_blocks(aes_block *output, aes_key *key, aes_block *input)
+{
+	const bs_key_word *sk = AES_BS_KEY(key);
+	bs_word q[8];
+	int r;
+
+	bs_load(q, input);
+	bs_add_round_key(q, sk);
+	for (r = 1; r < key->nbr; r++) {
+		bs_sbox(q);
+		bs_shift_rows(q);
+		bs_mix_columns(q);
+		bs_add_round_key(q, sk + 8 * r);
+	}
+	bs_sbox(q);
+	bs_shift_rows(q);
+	bs_add_round_key(q, sk + 8 * key->nbr);
+	bs_store(output, q);
+}
+
+void aes_bs_decrypt_blocks(aes_block *output, aes_key *key, aes_block *input)
+{
+	const bs_key_word *sk = AES_BS_KEY(key);
+	bs_word q[8];
+	int r;
+
+	bs_load(q, input);
+	bs_add_round_key(q, sk + 8 * key->nbr);
+	for (r = key->nbr - 1; r > 0; r--) {
+		bs_inv_shift_rows(q);
+		bs_inv_sbox(q);
+		bs_add_round_key(q, sk + 8 * r);
+		bs_inv_mix_columns(q);
+	}
+	bs_inv_shift_rows(q);
+	bs_inv_sbox(q);
+	bs_add_round_key(q, sk);
+	bs_store(output, q);
+}
+
+void aes_bs_encrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks)
+{
+	for ( ; nb_blocks >= AES_BS_BLOCKS; nb_blocks -= AES_BS_BLOCKS, input += AES_BS_BLOCKS, output += AES_BS_BLOCKS)
+		aes_bs_encrypt_blocks(output, key, input);
+	if (nb_blocks > 0) {
+		aes_block tmp[AES_BS_BLOCKS];
+		memory_zero(tmp, sizeof(tmp));
+		memcpy(tmp, input, 16 * nb_blocks);
+		aes_bs_encrypt_blocks(tmp, key, tmp);
+		memcpy(output, tmp, 16 * nb_blocks);
+		memory_zero(tmp, sizeof(tmp));
+	}
+}
+
+void aes_bs_decrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks)
+{
+	for ( ; nb_blocks >= AES_BS_BLOCKS; nb_blocks -= AES_BS_BLOCKS, input += AES_BS_BLOCKS, output += AES_BS_BLOCKS)
+		aes_bs_decrypt_blocks(output, key, input);
+	if (nb_blocks > 0) {
+		aes_block tmp[AES_BS_BLOCKS];
+		memory_zero(tmp, sizeof(tmp));
+		memcpy(tmp, input, 16 * nb_blocks);
+		aes_bs_decrypt_blocks(tmp, key, tmp);
+		memcpy(output, tmp, 16 * nb_blocks);
+		memory_zero(tmp, sizeof(tmp));
+	}
+}
+
+void aes_bs_decrypt_cbc(aes_block *output, aes_key *key, aes_block *ivini, aes_block *input, uint32_t nb_blocks)
+{
+	aes_block iv, in[AES_BS_BLOCKS], out[AES_BS_BLOCKS];
+	uint32_t i, n;
+
+	block128_copy(&iv, ivini);
+	for ( ; nb_blocks > 0; nb_blocks -= n, input += n, output += n) {
+		n = (nb_blocks < AES_BS_BLOCKS) ? nb_blocks : AES_BS_BLOCKS;
+		/* keep a copy of the ciphertext, output may alias input */
+		memory_zero(in, sizeof(in));
+		memcpy(in, input, 16 * n);
+		aes_bs_decrypt_blocks(out, key, in);
+		for (i = 0; i < n; i++) {
+			block128_vxor(&output[i], &out[i], &iv);
+			block128_copy(&iv, &in[i]);
+		}
+	}
+	memory_zero(out, sizeof(out));
+}
+
+void aes_bs_encrypt_ctr(uint8_t *output, aes_key *key, aes_block *iv, uint8_t *input, uint32_t len)
+{
+	aes_block ctr, ks[AES_BS_BLOCKS];
+	uint32_t i, n;
+
+	block128_copy(&ctr, iv);
+	for ( ; len > 0; len -= n, input += n, output += n) {
+		for (i = 0; i < AES_BS_BLOCKS; i++) {
+			block128_copy(&ks[i], &ctr);
+			block128_inc_be(&ctr);
+		}
+		aes_bs_encrypt_blocks(ks, key, ks);
+		if (len >= sizeof(ks)) {
+			n = sizeof(ks);
+			for (i = 0; i < AES_BS_BLOCKS; i++)
+				block128_vxor((block128 *) output + i, &ks[i], (block128 *) input + i);
+		} else {
+			n = len;
+			for (i = 0; i < n; i++)
+				output[i] = input[i] ^ ((const uint8_t *) ks)[i];
+		}
+	}
+	memory_zero(ks, sizeof(ks));
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2014 Vincent Hanquez <vincent@snarc.org>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of his contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * AES bitsliced implementation
+ */
+#ifndef AES_BITSLICE_H
+#define AES_BITSLICE_H
+
+#include "aes.h"
+
+/* a bitsliced word holds 4 blocks per 64 bits lane. with SSE2 the words are
+ * 128 bits wide and 8 blocks are processed at once. */
+#if defined(__GNUC__) && defined(__SSE2__)
+typedef uint64_t bs_word __attribute__ ((vector_size (16)));
+/* the bitsliced round keys are only as aligned as the key context, i.e. 8 bytes */
+typedef bs_word bs_key_word __attribute__ ((aligned (8)));
+#define AES_BS_LANES 2
+#else
+typedef uint64_t bs_word;
+typedef bs_word bs_key_word;
+#define AES_BS_LANES 1
+#endif
+
+#define AES_BS_BLOCKS (4 * AES_BS_LANES)
+
+/* bitsliced round keys, stored right after the aes_key: 8 words per round,
+ * one per bit plane */
+#define AES_BS_KEY(key) ((bs_key_word *) ((key) + 1))
+#define AES_BS_KEY_SIZE(size) (sizeof(bs_word) * 8 * ((size) / 4 + 7))
+
+void aes_bs_initkey(aes_key *key, uint8_t *origkey, uint8_t size);
+void aes_bs_encrypt_blocks(aes_block *output, aes_key *key, aes_block *input);
+void aes_bs_decrypt_blocks(aes_block *output, aes_key *key, aes_block *input);
+
+void aes_bs_encrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks);
+void aes_bs_decrypt_ecb(aes_block *output, aes_key *key, aes_block *input, uint32_t nb_blocks);
+void aes_bs_decrypt_cbc(aes_block *output, aes_key *key, aes_block *iv, aes_block *input, uint32_t nb_blocks);
+void aes_bs_encrypt_ctr(uint8_t *output, aes_key *key, aes_block *iv, uint8_t *input, uint32_t length);
+
+#endif
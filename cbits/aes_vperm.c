@@ -0,0 +1,464 @@
+/*
+ * Copyright (c) 2014 Vincent Hanquez <vincent@snarc.org>
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the author nor the names of his contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHORS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * AES implementation with vector permutes (SSSE3 pshufb), for x86 cpus
+ * without AES-NI.
+ *
+ * SubBytes is computed without any memory lookup, following the approach of
+ * M. Hamburg "Accelerating AES with Vector Permute Instructions": each byte
+ * is mapped to GF(2^4)[t]/(t^2 + t + 1/a), with a = 2 in GF(2^4)/(x^4 + x + 1),
+ * and written i.a.t + k. its inverse is then given by two 4 bits values:
+ *
+ *     j = i + k, io = 1/(1/i + a/k) + j, jo = 1/(1/j + a/k) + i
+ *
+ * where 1/0 is represented by 0x80, which pshufb turns back into a zero.
+ * every step is a 16 entries table indexed by a nibble, so a pshufb. the
+ * input tables map from the AES polynomial basis to (i, k), and the output
+ * tables map (io, jo) back to the AES basis, folding the S-box affine
+ * transformation, or the MixColumns coefficients, in the same lookups.
+ *
+ * the state and the round keys stay in the AES basis, so the key layout is
+ * the same as the other implementations.
+ */
+
+#ifdef WITH_AESNI
+
+#include <tmmintrin.h>
+#include <string.h>
+#include "aes.h"
+#include "aes_vperm.h"
+#include "bitfn.h"
+#include "block128.h"
+#include "cpu.h"
+#include "gf.h"
+
+#ifdef ARCH_X86
+
+enum {
+	VP_INV, VP_INVA,
+	VP_IPT, VP_IPT_HI, VP_DIPT, VP_DIPT_HI,
+	VP_SB1, VP_SB1_JO, VP_SB2, VP_SB2_JO,
+	VP_DSB1, VP_DSB1_JO, VP_DSBE, VP_DSBE_JO, VP_DSBB, VP_DSBB_JO,
+	VP_DSBD, VP_DSBD_JO, VP_DSB9, VP_DSB9_JO,
+	VP_SR, VP_INV_SR, VP_ROT1, VP_ROT2, VP_ROT3,
+};
+
+static const uint8_t vp_tables[][16] __attribute__((aligned(16))) = {
+	/* inv */
+	{ 0x80, 0x01, 0x09, 0x0e, 0x0d, 0x0b, 0x07, 0x06, 0x0f, 0x02, 0x0c, 0x05, 0x0a, 0x04, 0x03, 0x08 },
+	/* inva */
+	{ 0x80, 0x02, 0x01, 0x0f, 0x09, 0x05, 0x0e, 0x0c, 0x0d, 0x04, 0x0b, 0x0a, 0x07, 0x08, 0x06, 0x03 },
+	/* ipt lo */
+	{ 0x00, 0x01, 0x1c, 0x1d, 0x2d, 0x2c, 0x31, 0x30, 0x27, 0x26, 0x3b, 0x3a, 0x0a, 0x0b, 0x16, 0x17 },
+	/* ipt hi */
+	{ 0x00, 0x86, 0xfd, 0x7b, 0x8e, 0x08, 0x73, 0xf5, 0x77, 0xf1, 0x8a, 0x0c, 0xf9, 0x7f, 0x04, 0x82 },
+	/* dipt lo */
+	{ 0x2c, 0x99, 0xf0, 0x45, 0xf7, 0x42, 0x2b, 0x9e, 0x38, 0x8d, 0xe4, 0x51, 0xe3, 0x56, 0x3f, 0x8a },
+	/* dipt hi */
+	{ 0x00, 0xa7, 0xa8, 0x0f, 0xed, 0x4a, 0x45, 0xe2, 0xd1, 0x76, 0x79, 0xde, 0x3c, 0x9b, 0x94, 0x33 },
+	/* sb1 io */
+	{ 0x00, 0xcb, 0xd7, 0xb0, 0x21, 0x8d, 0x67, 0xac, 0x7b, 0x5a, 0xea, 0x3d, 0x46, 0xf6, 0x91, 0x1c },
+	/* sb1 jo */
+	{ 0x00, 0x9f, 0x61, 0x16, 0xc2, 0x2a, 0x77, 0xe8, 0x89, 0x4b, 0x5d, 0x3c, 0xb5, 0xa3, 0xd4, 0xfe },
+	/* sb2 io */
+	{ 0x00, 0x8d, 0xb5, 0x7b, 0x42, 0x01, 0xce, 0x43, 0xf6, 0xb4, 0xcf, 0x7a, 0x8c, 0xf7, 0x39, 0x38 },
+	/* sb2 jo */
+	{ 0x00, 0x25, 0xc2, 0x2c, 0x9f, 0x54, 0xee, 0xcb, 0x09, 0x96, 0xba, 0x78, 0x71, 0x5d, 0xb3, 0xe7 },
+	/* dsb1 io */
+	{ 0x00, 0x3b, 0xe4, 0xc8, 0x03, 0x14, 0x2c, 0x17, 0xf3, 0xf0, 0x38, 0xdc, 0x2f, 0xe7, 0xcb, 0xdf },
+	/* dsb1 jo */
+	{ 0x00, 0x24, 0x91, 0x19, 0x23, 0x8f, 0x88, 0xac, 0x3d, 0x1e, 0x07, 0x96, 0xab, 0xb2, 0x3a, 0xb5 },
+	/* dsbe io */
+	{ 0x00, 0x59, 0x0f, 0x9c, 0x12, 0xd8, 0x93, 0xca, 0xc5, 0xd7, 0x4b, 0x44, 0x81, 0x1d, 0x8e, 0x56 },
+	/* dsbe jo */
+	{ 0x00, 0xe3, 0xaf, 0x9e, 0xc9, 0x1b, 0x31, 0xd2, 0x7d, 0xb4, 0x2a, 0x85, 0xf8, 0x66, 0x57, 0x4c },
+	/* dsbb io */
+	{ 0x00, 0x8e, 0x56, 0x59, 0x1d, 0x9c, 0x0f, 0x81, 0xd7, 0xca, 0x93, 0xc5, 0x12, 0x4b, 0x44, 0xd8 },
+	/* dsbb jo */
+	{ 0x00, 0x57, 0x4c, 0xe3, 0x66, 0x9e, 0xaf, 0xf8, 0xb4, 0xd2, 0x31, 0x7d, 0xc9, 0x2a, 0x85, 0x1b },
+	/* dsbd io */
+	{ 0x00, 0x14, 0x38, 0xdf, 0x17, 0xe4, 0xe7, 0xf3, 0xcb, 0xdc, 0x03, 0x3b, 0xf0, 0x2f, 0xc8, 0x2c },
+	/* dsbd jo */
+	{ 0x00, 0x8f, 0x07, 0xb5, 0xac, 0x91, 0xb2, 0x3d, 0x3a, 0x96, 0x23, 0x24, 0x1e, 0xab, 0x19, 0x88 },
+	/* dsb9 io */
+	{ 0x00, 0xf8, 0x85, 0xd2, 0x1b, 0xb4, 0x57, 0xaf, 0x2a, 0x31, 0xe3, 0x66, 0x4c, 0x9e, 0xc9, 0x7d },
+	/* dsb9 jo */
+	{ 0x00, 0x1f, 0x75, 0xd1, 0x20, 0x9b, 0xa4, 0xbb, 0xce, 0xee, 0x3f, 0x4a, 0x84, 0x55, 0xf1, 0x6a },
+	/* shift rows */
+	{ 0x00, 0x05, 0x0a, 0x0f, 0x04, 0x09, 0x0e, 0x03, 0x08, 0x0d, 0x02, 0x07, 0x0c, 0x01, 0x06, 0x0b },
+	/* inverse shift rows */
+	{ 0x00, 0x0d, 0x0a, 0x07, 0x04, 0x01, 0x0e, 0x0b, 0x08, 0x05, 0x02, 0x0f, 0x0c, 0x09, 0x06, 0x03 },
+	/* rotate columns by one */
+	{ 0x01, 0x02, 0x03, 0x00, 0x05, 0x06, 0x07, 0x04, 0x09, 0x0a, 0x0b, 0x08, 0x0d, 0x0e, 0x0f, 0x0c },
+	/* rotate columns by two */
+	{ 0x02, 0x03, 0x00, 0x01, 0x06, 0x07, 0x04, 0x05, 0x0a, 0x0b, 0x08, 0x09, 0x0e, 0x0f, 0x0c, 0x0d },
+	/* rotate columns by three */
+	{ 0x03, 0x00, 0x01, 0x02, 0x07, 0x04, 0x05, 0x06, 0x0b, 0x08, 0x09, 0x0a, 0x0f, 0x0c, 0x0d, 0x0e },
+};
+
+#define VP_TABLE(t) _mm_load_si128((const __m128i *) vp_tables[t])
+
+/* map the bytes of x to the tower field with the input tables t (low nibble)
+ * and t+1 (high nibble), and compute the two halves io and jo of the inverse */
+static inline void vp_invert(__m128i x, int t, __m128i *io, __m128i *jo)
+{
+	const __m128i s0f = _mm_set1_epi8(0x0f);
+	const __m128i inv = VP_TABLE(VP_INV);
+	__m128i i, j, k, ak, iak, jak;
+
+	i = _mm_and_si128(_mm_srli_epi32(x, 4), s0f);
+	k = _mm_and_si128(x, s0f);
+	x = _mm_xor_si128(_mm_shuffle_epi8(VP_TABLE(t), k), _mm_shuffle_epi8(VP_TABLE(t + 1), i));
+
+	i = _mm_and_si128(_mm_srli_epi32(x, 4), s0f);
+	k = _mm_and_si128(x, s0f);
+	j = _mm_xor_si128(i, k);
+	ak = _mm_shuffle_epi8(VP_TABLE(VP_INVA), k);
+	iak = _mm_xor_si128(_mm_shuffle_epi8(inv, i), ak);
+	jak = _mm_xor_si128(_mm_shuffle_epi8(inv, j), ak);
+	*io = _mm_xor_si128(_mm_shuffle_epi8(inv, iak), j);
+	*jo = _mm_xor_si128(_mm_shuffle_epi8(inv, jak), i);
+}
+
+/* lookup of the inverse halves in the output tables t and t+1 */
+#define VP_OUT(t, io, jo) \
+	_mm_xor_si128(_mm_shuffle_epi8(VP_TABLE(t), io), _mm_shuffle_epi8(VP_TABLE((t) + 1), jo))
+
+#define VP_ROT(x, t) _mm_shuffle_epi8(x, VP_TABLE(t))
+
+/* encrypt n blocks, interleaving the rounds of the blocks since every
+ * step depends on the previous one */
+static inline void vp_encrypt_n(__m128i *m, int n, aes_key *key)
+{
+	/* the S-box constant goes through MixColumns unchanged */
+	const __m128i s63 = _mm_set1_epi8(0x63);
+	__m128i *k = (__m128i *) key->data;
+	__m128i io, jo, a, b, rk;
+	int r, i;
+
+	rk = _mm_loadu_si128(k);
+	for (i = 0; i < n; i++)
+		m[i] = _mm_xor_si128(m[i], rk);
+	for (r = 1; r < key->nbr; r++) {
+		rk = _mm_xor_si128(s63, _mm_loadu_si128(k + r));
+		for (i = 0; i < n; i++) {
+			vp_invert(VP_ROT(m[i], VP_SR), VP_IPT, &io, &jo);
+			/* a = S(x) and b = 2.S(x), less the constant:
+			 * 2a0 + 3a1 + a2 + a3 = (2a0 + a1) + (2a1 + a2) + a3 */
+			a = VP_OUT(VP_SB1, io, jo);
+			b = VP_OUT(VP_SB2, io, jo);
+			b = _mm_xor_si128(b, VP_ROT(a, VP_ROT1));
+			m[i] = _mm_xor_si128(b, VP_ROT(b, VP_ROT1));
+			m[i] = _mm_xor_si128(m[i], VP_ROT(a, VP_ROT3));
+			m[i] = _mm_xor_si128(m[i], rk);
+		}
+	}
+	rk = _mm_xor_si128(s63, _mm_loadu_si128(k + key->nbr));
+	for (i = 0; i < n; i++) {
+		vp_invert(VP_ROT(m[i], VP_SR), VP_IPT, &io, &jo);
+		m[i] = _mm_xor_si128(VP_OUT(VP_SB1, io, jo), rk);
+	}
+}
+
+static inline void vp_decrypt_n(__m128i *m, int n, aes_key *key)
+{
+	__m128i *k = (__m128i *) key->data;
+	__m128i io, jo, rk;
+	int r, i;
+
+	/* the decryption keys follow the last encryption key */
+	rk = _mm_loadu_si128(k + key->nbr);
+	for (i = 0; i < n; i++)
+		m[i] = _mm_xor_si128(m[i], rk);
+	for (r = 1; r < key->nbr; r++) {
+		rk = _mm_loadu_si128(k + key->nbr + r);
+		for (i = 0; i < n; i++) {
+			vp_invert(VP_ROT(m[i], VP_INV_SR), VP_DIPT, &io, &jo);
+			/* 14a0 + 11a1 + 13a2 + 9a3 */
+			m[i] = VP_OUT(VP_DSBE, io, jo);
+			m[i] = _mm_xor_si128(m[i], VP_ROT(VP_OUT(VP_DSBB, io, jo), VP_ROT1));
+			m[i] = _mm_xor_si128(m[i], VP_ROT(VP_OUT(VP_DSBD, io, jo), VP_ROT2));
+			m[i] = _mm_xor_si128(m[i], VP_ROT(VP_OUT(VP_DSB9, io, jo), VP_ROT3));
+			m[i] = _mm_xor_si128(m[i], rk);
+		}
+	}
+	rk = _mm_loadu_si128(k);
+	for (i = 0; i < n; i++) {
+		vp_invert(VP_ROT(m[i], VP_INV_SR), VP_DIPT, &io, &jo);
+		m[i] = _mm_xor_si128(VP_OUT(VP_DSB1, io, jo), rk);
+	}
+}
+
+static inline __m128i vp_encrypt(__m128i m, aes_key *key)
+{
+	vp_encrypt_n(&m, 1, key);
+	return m;
+}
+
+static inline __m128i vp_decrypt(__m128i m, aes_key *key)
+{
+	vp_decrypt_n(&m, 1, key);
+	return m;
+}
+
+static uint32_t vp_sub_word(uint32_t w)
+{
+	__m128i io, jo;
+
+	vp_invert(_mm_cvtsi32_si128(w), VP_IPT, &io, &jo);
+	return _mm_cvtsi128_si32(VP_OUT(VP_SB1, io, jo)) ^ 0x63636363;
+}
+
+static inline __m128i vp_xtime(__m128i x)
+{
+	__m128i hi = _mm_cmplt_epi8(x, _mm_setzero_si128());
+	return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(hi, _mm_set1_epi8(0x1b)));
+}
+
+/* InvMixColumns(x) = MixColumns(x + 4.(x + rot2(x))) */
+static __m128i vp_inv_mix_columns(__m128i x)
+{
+	__m128i t;
+
+	t = vp_xtime(vp_xtime(_mm_xor_si128(x, VP_ROT(x, VP_ROT2))));
+	x = _mm_xor_si128(x, t);
+	t = vp_xtime(_mm_xor_si128(x, VP_ROT(x, VP_ROT1)));
+	t = _mm_xor_si128(t, VP_ROT(x, VP_ROT1));
+	t = _mm_xor_si128(t, VP_ROT(x, VP_ROT2));
+	return _mm_xor_si128(t, VP_ROT(x, VP_ROT3));
+}
+
+void aes_vp_init(aes_key *key, uint8_t *origkey, uint8_t size)
+{
+	uint32_t w[60];
+	__m128i *k = (__m128i *) key->data;
+	uint32_t rcon = 0x01;
+	int nk = size / 4, i;
+
+	switch (size) {
+	case 16: key->nbr = 10; break;
+	case 24: key->nbr = 12; break;
+	case 32: key->nbr = 14; break;
+	default: return;
+	}
+
+	/* words are little endian: RotWord is a right rotation */
+	memcpy(w, origkey, size);
+	for (i = nk; i < 4 * (key->nbr + 1); i++) {
+		uint32_t t = w[i - 1];
+		if (i % nk == 0) {
+			t = vp_sub_word(ror32(t, 8)) ^ rcon;
+			rcon = (rcon << 1) ^ ((rcon >> 7) * 0x11b);
+		} else if (nk > 6 && i % nk == 4)
+			t = vp_sub_word(t);
+		w[i] = w[i - nk] ^ t;
+	}
+	memcpy(key->data, w, 16 * (key->nbr + 1));
+	memory_zero(w, sizeof(w));
+
+	for (i = 1; i < key->nbr; i++)
+		_mm_storeu_si128(k + key->nbr + i, vp_inv_mix_columns(_mm_loadu_si128(k + key->nbr - i)));
+}
+
+void aes_vp_encrypt_block(aes_block *out, aes_key *key, aes_block *in)
+{
+	__m128i m = _mm_loadu_si128((__m128i *) in);
+	_mm_storeu_si128((__m128i *) out, vp_encrypt(m, key));
+}
+
+void aes_vp_decrypt_block(aes_block *out, aes_key *key, aes_block *in)
+{
+	__m128i m = _mm_loadu_si128((__m128i *) in);
+	_mm_storeu_si128((__m128i *) out, vp_decrypt(m, key));
+}
+
+#define VP_LOAD4(m, in) do { \
+	m[0] = _mm_loadu_si128(((__m128i *) (in)) + 0); \
+	m[1] = _mm_loadu_si128(((__m128i *) (in)) + 1); \
+	m[2] = _mm_loadu_si128(((__m128i *) (in)) + 2); \
+	m[3] = _mm_loadu_si128(((__m128i *) (in)) + 3); \
+	} while (0)
+
+#define VP_STORE4(out, m) do { \
+	_mm_storeu_si128(((__m128i *) (out)) + 0, m[0]); \
+	_mm_storeu_si128(((__m128i *) (out)) + 1, m[1]); \
+	_mm_storeu_si128(((__m128i *) (out)) + 2, m[2]); \
+	_mm_storeu_si128(((__m128i *) (out)) + 3, m[3]); \
+	} while (0)
+
+void aes_vp_encrypt_ecb(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks)
+{
+	__m128i m[4];
+
+	for ( ; blocks >= 4; blocks -= 4, in += 4, out += 4) {
+		VP_LOAD4(m, in);
+		vp_encrypt_n(m, 4, key);
+		VP_STORE4(out, m);
+	}
+	for ( ; blocks-- > 0; in += 1, out += 1) {
+		__m128i m = _mm_loadu_si128((__m128i *) in);
+		_mm_storeu_si128((__m128i *) out, vp_encrypt(m, key));
+	}
+}
+
+void aes_vp_decrypt_ecb(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks)
+{
+	__m128i m[4];
+
+	for ( ; blocks >= 4; blocks -= 4, in += 4, out += 4) {
+		VP_LOAD4(m, in);
+		vp_decrypt_n(m, 4, key);
+		VP_STORE4(out, m);
+	}
+	for ( ; blocks-- > 0; in += 1, out += 1) {
+		__m128i m = _mm_loadu_si128((__m128i *) in);
+		_mm_storeu_si128((__m128i *) out, vp_decrypt(m, key));
+	}
+}
+
+void aes_vp_encrypt_cbc(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks)
+{
+	__m128i iv = _mm_loadu_si128((__m128i *) _iv);
+
+	for ( ; blocks-- > 0; in += 1, out += 1) {
+		__m128i m = _mm_loadu_si128((__m128i *) in);
+		iv = vp_encrypt(_mm_xor_si128(m, iv), key);
+		_mm_storeu_si128((__m128i *) out, iv);
+	}
+}
+
+void aes_vp_decrypt_cbc(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks)
+{
+	__m128i iv = _mm_loadu_si128((__m128i *) _iv);
+	__m128i m[4], c[4];
+
+	for ( ; blocks >= 4; blocks -= 4, in += 4, out += 4) {
+		VP_LOAD4(c, in);
+		m[0] = c[0]; m[1] = c[1]; m[2] = c[2]; m[3] = c[3];
+		vp_decrypt_n(m, 4, key);
+		m[0] = _mm_xor_si128(m[0], iv);
+		m[1] = _mm_xor_si128(m[1], c[0]);
+		m[2] = _mm_xor_si128(m[2], c[1]);
+		m[3] = _mm_xor_si128(m[3], c[2]);
+		iv = c[3];
+		VP_STORE4(out, m);
+	}
+	for ( ; blocks-- > 0; in += 1, out += 1) {
+		__m128i m = _mm_loadu_si128((__m128i *) in);
+		_mm_storeu_si128((__m128i *) out, _mm_xor_si128(vp_decrypt(m, key), iv));
+		iv = m;
+	}
+}
+
+void aes_vp_encrypt_ctr(uint8_t *out, aes_key *key, aes_block *_iv, uint8_t *in, uint32_t len)
+{
+	aes_block ctr, o;
+	__m128i m[4];
+	uint32_t i;
+
+	block128_copy(&ctr, _iv);
+	for ( ; len >= 64; len -= 64, in += 64, out += 64) {
+		for (i = 0; i < 4; i++, block128_inc_be(&ctr))
+			m[i] = _mm_loadu_si128((__m128i *) &ctr);
+		vp_encrypt_n(m, 4, key);
+		for (i = 0; i < 4; i++)
+			m[i] = _mm_xor_si128(m[i], _mm_loadu_si128(((__m128i *) in) + i));
+		VP_STORE4(out, m);
+	}
+	for ( ; len >= 16; len -= 16, in += 16, out += 16, block128_inc_be(&ctr)) {
+		__m128i m = vp_encrypt(_mm_loadu_si128((__m128i *) &ctr), key);
+		m = _mm_xor_si128(m, _mm_loadu_si128((__m128i *) in));
+		_mm_storeu_si128((__m128i *) out, m);
+	}
+	if (len > 0) {
+		_mm_storeu_si128((__m128i *) &o, vp_encrypt(_mm_loadu_si128((__m128i *) &ctr), key));
+		for (i = 0; i < len; i++)
+			out[i] = in[i] ^ o.b[i];
+	}
+}
+
+void aes_vp_encrypt_xts(aes_block *out, aes_key *key1, aes_key *key2,
+                        aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks)
+{
+	aes_block tweak;
+
+	__m128i m[4], t[4];
+	int i;
+
+	aes_vp_encrypt_block(&tweak, key2, _tweak);
+	gf_mulx_pow(&tweak, spoint);
+
+	for ( ; blocks >= 4; blocks -= 4, in += 4, out += 4) {
+		for (i = 0; i < 4; i++, gf_mulx(&tweak)) {
+			t[i] = _mm_loadu_si128((__m128i *) &tweak);
+			m[i] = _mm_xor_si128(_mm_loadu_si128(((__m128i *) in) + i), t[i]);
+		}
+		vp_encrypt_n(m, 4, key1);
+		for (i = 0; i < 4; i++)
+			m[i] = _mm_xor_si128(m[i], t[i]);
+		VP_STORE4(out, m);
+	}
+	for ( ; blocks-- > 0; in += 1, out += 1, gf_mulx(&tweak)) {
+		__m128i t = _mm_loadu_si128((__m128i *) &tweak);
+		__m128i m = _mm_xor_si128(_mm_loadu_si128((__m128i *) in), t);
+		_mm_storeu_si128((__m128i *) out, _mm_xor_si128(vp_encrypt(m, key1), t));
+	}
+}
+
+void aes_vp_decrypt_xts(aes_block *out, aes_key *key1, aes_key *key2,
+                        aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks)
+{
+	aes_block tweak;
+
+	__m128i m[4], t[4];
+	int i;
+
+	aes_vp_encrypt_block(&tweak, key2, _tweak);
+	gf_mulx_pow(&tweak, spoint);
+
+	for ( ; blocks >= 4; blocks -= 4, in += 4, out += 4) {
+		for (i = 0; i < 4; i++, gf_mulx(&tweak)) {
+			t[i] = _mm_loadu_si128((__m128i *) &tweak);
+			m[i] = _mm_xor_si128(_mm_loadu_si128(((__m128i *) in) + i), t[i]);
+		}
+		vp_decrypt_n(m, 4, key1);
+		for (i = 0; i < 4; i++)
+			m[i] = _mm_xor_si128(m[i], t[i]);
+		VP_STORE4(out, m);
+	}
+	for ( ; blocks-- > 0; in += 1, out += 1, gf_mulx(&tweak)) {
+		__m128i t = _mm_loadu_si128((__m128i *) &tweak);
+		__m128i m = _mm_xor_si128(_mm_loadu_si128((__m128i *) in), t);
+		_mm_storeu_si128((__m128i *) out, _mm_xor_si128(vp_decrypt(m, key1), t));
+	}
+}
+
+#endif
+
+#endif
@@ -37,6 +37,7 @@
 #include "aes_x86ni.h"
 #include "block128.h"
 #include "cpu.h"
+#include "gf.h"
 
 #ifdef ARCH_X86
 #define ALIGN_UP(addr, size) (((addr) + ((size) - 1)) & (~((size) - 1)))
@@ -63,6 +64,36 @@ static __m128i aes_128_key_expansion_aa(__m128i key, __m128i keygened)
 	return _mm_xor_si128(key, keygened);
 }
 
+/* the 192 bits key is carried as a full 128 bits word (t1) and a half word
+ * in the low 64 bits of t3; each call produces the next 6 words of schedule */
+static void aes_192_key_expansion(__m128i *t1, __m128i *t3, __m128i keygened)
+{
+	__m128i k1 = *t1, k3 = *t3;
+
+	keygened = _mm_shuffle_epi32(keygened, 0x55);
+	k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+	k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+	k1 = _mm_xor_si128(k1, _mm_slli_si128(k1, 4));
+	k1 = _mm_xor_si128(k1, keygened);
+	keygened = _mm_shuffle_epi32(k1, 0xff);
+	k3 = _mm_xor_si128(k3, _mm_slli_si128(k3, 4));
+	k3 = _mm_xor_si128(k3, keygened);
+	*t1 = k1;
+	*t3 = k3;
+}
+
+/* glue the low 64 bits of a and the low 64 bits of b */
+static inline __m128i shuffle_lo(__m128i a, __m128i b)
+{
+	return _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 0));
+}
+
+/* glue the high 64 bits of a and the low 64 bits of b */
+static inline __m128i shuffle_hilo(__m128i a, __m128i b)
+{
+	return _mm_castpd_si128(_mm_shuffle_pd(_mm_castsi128_pd(a), _mm_castsi128_pd(b), 1));
+}
+
 void aes_ni_init(aes_key *key, uint8_t *ikey, uint8_t size)
 {
 	__m128i k[28];
@@ -101,6 +132,52 @@ void aes_ni_init(aes_key *key, uint8_t *ikey, uint8_t size)
 		for (i = 0; i < 20; i++)
 			_mm_storeu_si128(((__m128i *) out) + i, k[i]);
 		break;
+	case 24: {
+		__m128i t1, t3;
+#define AES_192_key_exp(RCON) aes_192_key_expansion(&t1, &t3, _mm_aeskeygenassist_si128(t3, RCON))
+		t1 = _mm_loadu_si128((const __m128i*) ikey);
+		t3 = _mm_loadl_epi64((const __m128i*) (ikey+16));
+		k[0]  = t1;
+		k[1]  = t3;
+		AES_192_key_exp(0x01);
+		k[1]  = shuffle_lo(k[1], t1);
+		k[2]  = shuffle_hilo(t1, t3);
+		AES_192_key_exp(0x02);
+		k[3]  = t1;
+		k[4]  = t3;
+		AES_192_key_exp(0x04);
+		k[4]  = shuffle_lo(k[4], t1);
+		k[5]  = shuffle_hilo(t1, t3);
+		AES_192_key_exp(0x08);
+		k[6]  = t1;
+		k[7]  = t3;
+		AES_192_key_exp(0x10);
+		k[7]  = shuffle_lo(k[7], t1);
+		k[8]  = shuffle_hilo(t1, t3);
+		AES_192_key_exp(0x20);
+		k[9]  = t1;
+		k[10] = t3;
+		AES_192_key_exp(0x40);
+		k[10] = shuffle_lo(k[10], t1);
+		k[11] = shuffle_hilo(t1, t3);
+		AES_192_key_exp(0x80);
+		k[12] = t1;
+
+		k[13] = _mm_aesimc_si128(k[11]);
+		k[14] = _mm_aesimc_si128(k[10]);
+		k[15] = _mm_aesimc_si128(k[9]);
+		k[16] = _mm_aesimc_si128(k[8]);
+		k[17] = _mm_aesimc_si128(k[7]);
+		k[18] = _mm_aesimc_si128(k[6]);
+		k[19] = _mm_aesimc_si128(k[5]);
+		k[20] = _mm_aesimc_si128(k[4]);
+		k[21] = _mm_aesimc_si128(k[3]);
+		k[22] = _mm_aesimc_si128(k[2]);
+		k[23] = _mm_aesimc_si128(k[1]);
+		for (i = 0; i < 24; i++)
+			_mm_storeu_si128(((__m128i *) out) + i, k[i]);
+		break;
+	}
 	case 32:
 #define AES_256_key_exp_1(K1, K2, RCON) aes_128_key_expansion_ff(K1, _mm_aeskeygenassist_si128(K2, RCON))
 #define AES_256_key_exp_2(K1, K2)       aes_128_key_expansion_aa(K1, _mm_aeskeygenassist_si128(K2, 0x00))
@@ -141,54 +218,185 @@ void aes_ni_init(aes_key *key, uint8_t *ikey, uint8_t size)
 	}
 }
 
-/* TO OPTIMISE: use pcmulqdq... or some faster code.
- * this is the lamest way of doing it, but i'm out of time.
- * this is basically a copy of gf_mulx in gf.c */
-static __m128i gfmulx(__m128i v)
+/* multiply the tweak by x in GF(2^128) as defined by XTS (little endian),
+ * same as gf_mulx in gf.c. each 32 bits word is shifted left by one, and
+ * the bits shifted out are carried into the next word, the top one being
+ * folded back as 0x87 into the lowest word */
+static inline __m128i gfmulx(__m128i v)
+{
+	__m128i r = _mm_set_epi32(1, 1, 1, 0x87);
+	__m128i t = _mm_srai_epi32(v, 31);
+
+	t = _mm_shuffle_epi32(t, 0x93);
+	t = _mm_and_si128(t, r);
+	return _mm_xor_si128(_mm_add_epi32(v, v), t);
+}
+
+/* increment a counter block that has been byte swapped in each 64 bits lane
+ * (lane 1 holding the least significant half), carrying into lane 0 */
+static inline __m128i ctr_inc(__m128i iv, __m128i one)
+{
+	__m128i z;
+
+	iv = _mm_add_epi64(iv, one);
+	/* all ones in lanes that wrapped to zero */
+	z = _mm_cmpeq_epi32(iv, _mm_setzero_si128());
+	z = _mm_and_si128(z, _mm_shuffle_epi32(z, 0xb1));
+	/* move lane 1 wrap indicator to lane 0 and subtract -1 */
+	z = _mm_srli_si128(z, 8);
+	return _mm_sub_epi64(iv, z);
+}
+
+/* accumulate the unreduced product of a and b in GF(2^128) as defined by
+ * GHASH, using carry-less multiplication. both operands are byte-reflected
+ * (see gf_mul_x86ni), which is the form carry-less multiply naturally works in.
+ * the 256 bits product is kept as three parts: lo, hi and the middle terms
+ * which overlap both, so that the products of several blocks can be summed
+ * before doing a single gfmul_clmul_reduce.
+ *
+ * the middle terms use karatsuba: bk holds the xor of the two 64 bits
+ * halves of b in its low half, and the product (a0+a1)(b0+b1) only gets the
+ * lo and hi parts removed at reduction. */
+static inline void gfmul_clmul_acc(__m128i a, __m128i b, __m128i bk, __m128i *lo, __m128i *mid, __m128i *hi)
+{
+	__m128i ak = _mm_xor_si128(a, _mm_shuffle_epi32(a, 0x4e));
+
+	*lo  = _mm_xor_si128(*lo, _mm_clmulepi64_si128(a, b, 0x00));
+	*hi  = _mm_xor_si128(*hi, _mm_clmulepi64_si128(a, b, 0x11));
+	*mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(ak, bk, 0x00));
+}
+
+/* turn an accumulated product back into a field element: the 256 bits
+ * value is shifted by one and then reduced modulo x^128 + x^7 + x^2 + x + 1.
+ * both steps are linear, so reducing a sum of products is the same
+ * as summing the reduced products. */
+static inline __m128i gfmul_clmul_reduce(__m128i lo, __m128i mid, __m128i hi)
+{
+	__m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+	mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+	t5 = _mm_slli_si128(mid, 8);
+	t4 = _mm_srli_si128(mid, 8);
+	t3 = _mm_xor_si128(lo, t5);
+	t6 = _mm_xor_si128(hi, t4);
+
+	/* shift the 256 bits result <t6:t3> left by one */
+	t7 = _mm_srli_epi32(t3, 31);
+	t8 = _mm_srli_epi32(t6, 31);
+	t3 = _mm_slli_epi32(t3, 1);
+	t6 = _mm_slli_epi32(t6, 1);
+	t9 = _mm_srli_si128(t7, 12);
+	t8 = _mm_slli_si128(t8, 4);
+	t7 = _mm_slli_si128(t7, 4);
+	t3 = _mm_or_si128(t3, t7);
+	t6 = _mm_or_si128(t6, t8);
+	t6 = _mm_or_si128(t6, t9);
+
+	/* reduce */
+	t7 = _mm_slli_epi32(t3, 31);
+	t8 = _mm_slli_epi32(t3, 30);
+	t9 = _mm_slli_epi32(t3, 25);
+	t7 = _mm_xor_si128(t7, t8);
+	t7 = _mm_xor_si128(t7, t9);
+	t8 = _mm_srli_si128(t7, 4);
+	t7 = _mm_slli_si128(t7, 12);
+	t3 = _mm_xor_si128(t3, t7);
+
+	t2 = _mm_srli_epi32(t3, 1);
+	t4 = _mm_srli_epi32(t3, 2);
+	t5 = _mm_srli_epi32(t3, 7);
+	t2 = _mm_xor_si128(t2, t4);
+	t2 = _mm_xor_si128(t2, t5);
+	t2 = _mm_xor_si128(t2, t8);
+	t3 = _mm_xor_si128(t3, t2);
+	return _mm_xor_si128(t6, t3);
+}
+
+/* multiply a and b in GF(2^128), operands and result byte-reflected */
+static inline __m128i gfmul_clmul(__m128i a, __m128i b)
+{
+	__m128i lo = _mm_setzero_si128();
+	__m128i mid = _mm_setzero_si128();
+	__m128i hi = _mm_setzero_si128();
+	__m128i bk = _mm_xor_si128(b, _mm_shuffle_epi32(b, 0x4e));
+
+	gfmul_clmul_acc(a, b, bk, &lo, &mid, &hi);
+	return gfmul_clmul_reduce(lo, mid, hi);
+}
+
+/* with pclmulqdq, no multiplication table is needed. instead the powers
+ * H^1 to H^8 are kept byte-reflected in the first 8 entries, and their
+ * karatsuba halves (see gfmul_clmul_acc) in the next 8, so that ghash_add8
+ * can hash 8 blocks with a single reduction. */
+void gf_ghash_init_x86ni(block128 *htable, block128 *h)
 {
-	uint64_t v_[2] ALIGNMENT(16);
-	const uint64_t gf_mask = 0x8000000000000000;
-
-	_mm_store_si128((__m128i *) v_, v);
-	uint64_t r = ((v_[1] & gf_mask) ? 0x87 : 0);
-	v_[1] = (v_[1] << 1) | (v_[0] & gf_mask ? 1 : 0);
-	v_[0] = (v_[0] << 1) ^ r;
-	v = _mm_load_si128((__m128i *) v_);
-	return v;
+	__m128i ghash_mask = _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+	__m128i vh = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) h), ghash_mask);
+	__m128i hp = vh;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		if (i > 0)
+			hp = gfmul_clmul(hp, vh);
+		_mm_storeu_si128((__m128i *) &htable[i], hp);
+		_mm_storeu_si128((__m128i *) &htable[8+i], _mm_xor_si128(hp, _mm_shuffle_epi32(hp, 0x4e)));
+	}
 }
 
-static void unopt_gf_mul(block128 *a, block128 *b)
+/* inplace a = a * H, same as gf_ghash_mul in gf.c but using pclmulqdq */
+void gf_ghash_mul_x86ni(block128 *a, block128 *htable)
 {
-	uint64_t a0, a1, v0, v1;
-	int i, j;
-
-	a0 = a1 = 0;
-	v0 = cpu_to_be64(a->q[0]);
-	v1 = cpu_to_be64(a->q[1]);
-
-	for (i = 0; i < 16; i++)
-		for (j = 0x80; j != 0; j >>= 1) {
-			uint8_t x = b->b[i] & j;
-			a0 ^= x ? v0 : 0;
-			a1 ^= x ? v1 : 0;
-			x = (uint8_t) v1 & 1;
-			v1 = (v1 >> 1) | (v0 << 63);
-			v0 = (v0 >> 1) ^ (x ? (0xe1ULL << 56) : 0);
-		}
-	a->q[0] = cpu_to_be64(a0);
-	a->q[1] = cpu_to_be64(a1);
+	__m128i bswap_mask = _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+	__m128i va = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) a), bswap_mask);
+	__m128i vh = _mm_loadu_si128((__m128i *) &htable[0]);
+	va = gfmul_clmul(va, vh);
+	_mm_storeu_si128((__m128i *) a, _mm_shuffle_epi8(va, bswap_mask));
 }
 
-static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
+/* tag, h and m are all byte-reflected */
+static inline __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 {
-	aes_block _t, _h;
 	tag = _mm_xor_si128(tag, m);
+	return gfmul_clmul(tag, h);
+}
+
+/* hash 8 blocks of input into the byte-reflected tag, using the powers of H
+ * from gf_ghash_init_x86ni:
+ *   (tag + m0).H^8 + m1.H^7 + ... + m7.H
+ * the products are independent from each other, and only reduced once */
+static inline __m128i ghash_add8(__m128i tag, block128 *htable, uint8_t *input)
+{
+	__m128i ghash_mask = _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+	__m128i lo = _mm_setzero_si128();
+	__m128i mid = _mm_setzero_si128();
+	__m128i hi = _mm_setzero_si128();
+	__m128i m;
+	int i;
+
+	m = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) input), ghash_mask);
+	m = _mm_xor_si128(m, tag);
+	gfmul_clmul_acc(m, _mm_loadu_si128((__m128i *) &htable[7]),
+	                _mm_loadu_si128((__m128i *) &htable[15]), &lo, &mid, &hi);
+	for (i = 1; i < 8; i++) {
+		m = _mm_shuffle_epi8(_mm_loadu_si128(((__m128i *) input)+i), ghash_mask);
+		gfmul_clmul_acc(m, _mm_loadu_si128((__m128i *) &htable[7-i]),
+		                _mm_loadu_si128((__m128i *) &htable[15-i]), &lo, &mid, &hi);
+	}
+	return gfmul_clmul_reduce(lo, mid, hi);
+}
 
-	_mm_store_si128((__m128i *) &_t, tag);
-	_mm_store_si128((__m128i *) &_h, h);
-	unopt_gf_mul(&_t, &_h);
-	tag = _mm_load_si128((__m128i *) &_t);
-	return tag;
+/* same as gf_ghash_blocks in gf.c, 8 blocks at a time using ghash_add8 */
+void gf_ghash_blocks_x86ni(block128 *tag, block128 *htable, uint8_t *input, uint32_t nb_blocks)
+{
+	__m128i ghash_mask = _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+	__m128i h = _mm_loadu_si128((__m128i *) &htable[0]);
+	__m128i t = _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) tag), ghash_mask);
+
+	for (; nb_blocks >= 8; nb_blocks -= 8, input += 16*8)
+		t = ghash_add8(t, htable, input);
+	for (; nb_blocks > 0; nb_blocks--, input += 16)
+		t = ghash_add(t, h, _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) input), ghash_mask));
+	_mm_storeu_si128((__m128i *) tag, _mm_shuffle_epi8(t, ghash_mask));
 }
 
 #define PRELOAD_ENC_KEYS128(k) \
@@ -204,6 +412,11 @@ static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 	__m128i K9  = _mm_loadu_si128(((__m128i *) k)+9); \
 	__m128i K10 = _mm_loadu_si128(((__m128i *) k)+10);
 
+#define PRELOAD_ENC_KEYS192(k) \
+	PRELOAD_ENC_KEYS128(k) \
+	__m128i K11 = _mm_loadu_si128(((__m128i *) k)+11); \
+	__m128i K12 = _mm_loadu_si128(((__m128i *) k)+12);
+
 #define PRELOAD_ENC_KEYS256(k) \
 	PRELOAD_ENC_KEYS128(k) \
 	__m128i K11 = _mm_loadu_si128(((__m128i *) k)+11); \
@@ -224,6 +437,21 @@ static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 	m = _mm_aesenc_si128(m, K9); \
 	m = _mm_aesenclast_si128(m, K10);
 
+#define DO_ENC_BLOCK192(m) \
+	m = _mm_xor_si128(m, K0); \
+	m = _mm_aesenc_si128(m, K1); \
+	m = _mm_aesenc_si128(m, K2); \
+	m = _mm_aesenc_si128(m, K3); \
+	m = _mm_aesenc_si128(m, K4); \
+	m = _mm_aesenc_si128(m, K5); \
+	m = _mm_aesenc_si128(m, K6); \
+	m = _mm_aesenc_si128(m, K7); \
+	m = _mm_aesenc_si128(m, K8); \
+	m = _mm_aesenc_si128(m, K9); \
+	m = _mm_aesenc_si128(m, K10); \
+	m = _mm_aesenc_si128(m, K11); \
+	m = _mm_aesenclast_si128(m, K12);
+
 #define DO_ENC_BLOCK256(m) \
 	m = _mm_xor_si128(m, K0); \
 	m = _mm_aesenc_si128(m, K1); \
@@ -258,6 +486,12 @@ static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 	PRELOAD_DEC_KEYS_AT(k, 10) \
 	__m128i K10 = _mm_loadu_si128(((__m128i *) k)+0);
 
+#define PRELOAD_DEC_KEYS192(k) \
+	PRELOAD_DEC_KEYS_AT(k, 12) \
+	__m128i K10 = _mm_loadu_si128(((__m128i *) k)+12+10); \
+	__m128i K11 = _mm_loadu_si128(((__m128i *) k)+12+11); \
+	__m128i K12 = _mm_loadu_si128(((__m128i *) k)+0);
+
 #define PRELOAD_DEC_KEYS256(k) \
 	PRELOAD_DEC_KEYS_AT(k, 14) \
 	__m128i K10 = _mm_loadu_si128(((__m128i *) k)+14+10); \
@@ -279,6 +513,21 @@ static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 	m = _mm_aesdec_si128(m, K9); \
 	m = _mm_aesdeclast_si128(m, K10);
 
+#define DO_DEC_BLOCK192(m) \
+	m = _mm_xor_si128(m, K0); \
+	m = _mm_aesdec_si128(m, K1); \
+	m = _mm_aesdec_si128(m, K2); \
+	m = _mm_aesdec_si128(m, K3); \
+	m = _mm_aesdec_si128(m, K4); \
+	m = _mm_aesdec_si128(m, K5); \
+	m = _mm_aesdec_si128(m, K6); \
+	m = _mm_aesdec_si128(m, K7); \
+	m = _mm_aesdec_si128(m, K8); \
+	m = _mm_aesdec_si128(m, K9); \
+	m = _mm_aesdec_si128(m, K10); \
+	m = _mm_aesdec_si128(m, K11); \
+	m = _mm_aesdeclast_si128(m, K12);
+
 #define DO_DEC_BLOCK256(m) \
 	m = _mm_xor_si128(m, K0); \
 	m = _mm_aesdec_si128(m, K1); \
@@ -296,12 +545,143 @@ static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 	m = _mm_aesdec_si128(m, K13); \
 	m = _mm_aesdeclast_si128(m, K14);
 
+/* round keys K1 to Kn, F being applied on each middle round and L on the last.
+ * the decryption keys are preloaded with the same names, so it's valid for both directions */
+#define ROUNDS128(F, L) \
+	F(K1) F(K2) F(K3) F(K4) F(K5) F(K6) F(K7) F(K8) F(K9) L(K10)
+
+#define ROUNDS192(F, L) \
+	F(K1) F(K2) F(K3) F(K4) F(K5) F(K6) F(K7) F(K8) F(K9) \
+	F(K10) F(K11) L(K12)
+
+#define ROUNDS256(F, L) \
+	F(K1) F(K2) F(K3) F(K4) F(K5) F(K6) F(K7) F(K8) F(K9) \
+	F(K10) F(K11) F(K12) F(K13) L(K14)
+
+/* interleaved rounds on m0..m3 and m0..m7, so that the aes unit can
+ * pipeline independent blocks instead of waiting on the previous round */
+#define OP4(op, k) \
+	m0 = op(m0, k); m1 = op(m1, k); m2 = op(m2, k); m3 = op(m3, k);
+
+#define OP8(op, k) \
+	OP4(op, k) \
+	m4 = op(m4, k); m5 = op(m5, k); m6 = op(m6, k); m7 = op(m7, k);
+
+#define XOR4(k)        OP4(_mm_xor_si128, k)
+#define AESENC4(k)     OP4(_mm_aesenc_si128, k)
+#define AESENCLAST4(k) OP4(_mm_aesenclast_si128, k)
+#define AESDEC4(k)     OP4(_mm_aesdec_si128, k)
+#define AESDECLAST4(k) OP4(_mm_aesdeclast_si128, k)
+
+#define XOR8(k)        OP8(_mm_xor_si128, k)
+#define AESENC8(k)     OP8(_mm_aesenc_si128, k)
+#define AESENCLAST8(k) OP8(_mm_aesenclast_si128, k)
+#define AESDEC8(k)     OP8(_mm_aesdec_si128, k)
+#define AESDECLAST8(k) OP8(_mm_aesdeclast_si128, k)
+
+#define DO_ENC_BLOCK4 XOR4(K0) ROUNDS(AESENC4, AESENCLAST4)
+#define DO_ENC_BLOCK8 XOR8(K0) ROUNDS(AESENC8, AESENCLAST8)
+#define DO_DEC_BLOCK4 XOR4(K0) ROUNDS(AESDEC4, AESDECLAST4)
+#define DO_DEC_BLOCK8 XOR8(K0) ROUNDS(AESDEC8, AESDECLAST8)
+
+#define LOAD4(p) \
+	m0 = _mm_loadu_si128(((__m128i *) (p))+0); \
+	m1 = _mm_loadu_si128(((__m128i *) (p))+1); \
+	m2 = _mm_loadu_si128(((__m128i *) (p))+2); \
+	m3 = _mm_loadu_si128(((__m128i *) (p))+3);
+
+#define LOAD8(p) \
+	LOAD4(p) \
+	m4 = _mm_loadu_si128(((__m128i *) (p))+4); \
+	m5 = _mm_loadu_si128(((__m128i *) (p))+5); \
+	m6 = _mm_loadu_si128(((__m128i *) (p))+6); \
+	m7 = _mm_loadu_si128(((__m128i *) (p))+7);
+
+#define STORE4(p) \
+	_mm_storeu_si128(((__m128i *) (p))+0, m0); \
+	_mm_storeu_si128(((__m128i *) (p))+1, m1); \
+	_mm_storeu_si128(((__m128i *) (p))+2, m2); \
+	_mm_storeu_si128(((__m128i *) (p))+3, m3);
+
+#define STORE8(p) \
+	STORE4(p) \
+	_mm_storeu_si128(((__m128i *) (p))+4, m4); \
+	_mm_storeu_si128(((__m128i *) (p))+5, m5); \
+	_mm_storeu_si128(((__m128i *) (p))+6, m6); \
+	_mm_storeu_si128(((__m128i *) (p))+7, m7);
+
+/* xor m0..m7 with 8 blocks of input, e.g. to apply a counter keystream */
+#define XOR_IN8(p) \
+	m0 = _mm_xor_si128(m0, _mm_loadu_si128(((__m128i *) (p))+0)); \
+	m1 = _mm_xor_si128(m1, _mm_loadu_si128(((__m128i *) (p))+1)); \
+	m2 = _mm_xor_si128(m2, _mm_loadu_si128(((__m128i *) (p))+2)); \
+	m3 = _mm_xor_si128(m3, _mm_loadu_si128(((__m128i *) (p))+3)); \
+	m4 = _mm_xor_si128(m4, _mm_loadu_si128(((__m128i *) (p))+4)); \
+	m5 = _mm_xor_si128(m5, _mm_loadu_si128(((__m128i *) (p))+5)); \
+	m6 = _mm_xor_si128(m6, _mm_loadu_si128(((__m128i *) (p))+6)); \
+	m7 = _mm_xor_si128(m7, _mm_loadu_si128(((__m128i *) (p))+7));
+
+/* OCB offsets of 4 or 8 consecutive blocks following a block index multiple
+ * of 8, so that ntz of their indexes is 0,1,0,2,0,1,0 and at least 3 for the
+ * 8th one, whose L is passed in l */
+#define OCB_OFFSETS4(off) \
+	o0 = _mm_xor_si128(off, l0); \
+	o1 = _mm_xor_si128(o0, l1); \
+	o2 = _mm_xor_si128(o1, l0); \
+	o3 = _mm_xor_si128(o2, l2);
+
+#define OCB_OFFSETS8(off, l) \
+	OCB_OFFSETS4(off) \
+	o4 = _mm_xor_si128(o3, l0); \
+	o5 = _mm_xor_si128(o4, l1); \
+	o6 = _mm_xor_si128(o5, l0); \
+	o7 = _mm_xor_si128(o6, l);
+
+/* xor each block with its own whitening value: OCB offsets or XTS tweaks */
+#define XOR_O4 \
+	m0 = _mm_xor_si128(m0, o0); m1 = _mm_xor_si128(m1, o1); \
+	m2 = _mm_xor_si128(m2, o2); m3 = _mm_xor_si128(m3, o3);
+
+#define XOR_O8 \
+	XOR_O4 \
+	m4 = _mm_xor_si128(m4, o4); m5 = _mm_xor_si128(m5, o5); \
+	m6 = _mm_xor_si128(m6, o6); m7 = _mm_xor_si128(m7, o7);
+
+/* checksum of m0..m3 and m0..m7 into s */
+#define SUM4(s) \
+	s = _mm_xor_si128(s, _mm_xor_si128(_mm_xor_si128(m0, m1), _mm_xor_si128(m2, m3)));
+
+#define SUM8(s) \
+	SUM4(s) \
+	s = _mm_xor_si128(s, _mm_xor_si128(_mm_xor_si128(m4, m5), _mm_xor_si128(m6, m7)));
+
 #define SIZE 128
 #define SIZED(m) m##128
 #define PRELOAD_ENC PRELOAD_ENC_KEYS128
 #define DO_ENC_BLOCK DO_ENC_BLOCK128
 #define PRELOAD_DEC PRELOAD_DEC_KEYS128
 #define DO_DEC_BLOCK DO_DEC_BLOCK128
+#define ROUNDS ROUNDS128
+#define NB_ROUNDS 10
+#include "aes_x86ni_impl.c"
+
+#undef SIZE
+#undef SIZED
+#undef PRELOAD_ENC
+#undef PRELOAD_DEC
+#undef DO_ENC_BLOCK
+#undef DO_DEC_BLOCK
+#undef ROUNDS
+#undef NB_ROUNDS
+
+#define SIZED(m) m##192
+#define SIZE 192
+#define PRELOAD_ENC PRELOAD_ENC_KEYS192
+#define DO_ENC_BLOCK DO_ENC_BLOCK192
+#define PRELOAD_DEC PRELOAD_DEC_KEYS192
+#define DO_DEC_BLOCK DO_DEC_BLOCK192
+#define ROUNDS ROUNDS192
+#define NB_ROUNDS 12
 #include "aes_x86ni_impl.c"
 
 #undef SIZE
@@ -310,6 +690,8 @@ static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 #undef PRELOAD_DEC
 #undef DO_ENC_BLOCK
 #undef DO_DEC_BLOCK
+#undef ROUNDS
+#undef NB_ROUNDS
 
 #define SIZED(m) m##256
 #define SIZE 256
@@ -317,6 +699,8 @@ static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 #define DO_ENC_BLOCK DO_ENC_BLOCK256
 #define PRELOAD_DEC PRELOAD_DEC_KEYS256
 #define DO_DEC_BLOCK DO_DEC_BLOCK256
+#define ROUNDS ROUNDS256
+#define NB_ROUNDS 14
 #include "aes_x86ni_impl.c"
 
 #undef SIZE
@@ -325,6 +709,8 @@ static __m128i ghash_add(__m128i tag, __m128i h, __m128i m)
 #undef PRELOAD_DEC
 #undef DO_ENC_BLOCK
 #undef DO_DEC_BLOCK
+#undef ROUNDS
+#undef NB_ROUNDS
 
 #endif
 
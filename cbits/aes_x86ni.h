@@ -51,28 +51,71 @@ static void block128_sse_print(__m128i m)
 
 void aes_ni_init(aes_key *key, uint8_t *origkey, uint8_t size);
 void aes_ni_encrypt_block128(aes_block *out, aes_key *key, aes_block *in);
+void aes_ni_encrypt_block192(aes_block *out, aes_key *key, aes_block *in);
 void aes_ni_encrypt_block256(aes_block *out, aes_key *key, aes_block *in);
 void aes_ni_decrypt_block128(aes_block *out, aes_key *key, aes_block *in);
+void aes_ni_decrypt_block192(aes_block *out, aes_key *key, aes_block *in);
 void aes_ni_decrypt_block256(aes_block *out, aes_key *key, aes_block *in);
+void aes_ni_encrypt_block8128(aes_block *out, aes_key **keys, aes_block *in);
+void aes_ni_encrypt_block8192(aes_block *out, aes_key **keys, aes_block *in);
+void aes_ni_encrypt_block8256(aes_block *out, aes_key **keys, aes_block *in);
 void aes_ni_encrypt_ecb128(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks);
+void aes_ni_encrypt_ecb192(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks);
 void aes_ni_encrypt_ecb256(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks);
 void aes_ni_decrypt_ecb128(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks);
+void aes_ni_decrypt_ecb192(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks);
 void aes_ni_decrypt_ecb256(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks);
 void aes_ni_encrypt_cbc128(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks);
+void aes_ni_encrypt_cbc192(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks);
 void aes_ni_encrypt_cbc256(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks);
+void aes_ni_encrypt_cbc4128(aes_block **out, aes_key **keys, aes_block *ivs, aes_block **in, uint32_t blocks);
+void aes_ni_encrypt_cbc4192(aes_block **out, aes_key **keys, aes_block *ivs, aes_block **in, uint32_t blocks);
+void aes_ni_encrypt_cbc4256(aes_block **out, aes_key **keys, aes_block *ivs, aes_block **in, uint32_t blocks);
+void aes_ni_encrypt_cbc8128(aes_block **out, aes_key **keys, aes_block *ivs, aes_block **in, uint32_t blocks);
+void aes_ni_encrypt_cbc8192(aes_block **out, aes_key **keys, aes_block *ivs, aes_block **in, uint32_t blocks);
+void aes_ni_encrypt_cbc8256(aes_block **out, aes_key **keys, aes_block *ivs, aes_block **in, uint32_t blocks);
 void aes_ni_decrypt_cbc128(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks);
+void aes_ni_decrypt_cbc192(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks);
 void aes_ni_decrypt_cbc256(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks);
 void aes_ni_encrypt_ctr128(uint8_t *out, aes_key *key, aes_block *_iv, uint8_t *in, uint32_t length);
+void aes_ni_encrypt_ctr192(uint8_t *out, aes_key *key, aes_block *_iv, uint8_t *in, uint32_t length);
 void aes_ni_encrypt_ctr256(uint8_t *out, aes_key *key, aes_block *_iv, uint8_t *in, uint32_t length);
+void aes_ni_gen_ctr128(aes_block *out, aes_key *key, aes_block *_iv, uint32_t blocks);
+void aes_ni_gen_ctr192(aes_block *out, aes_key *key, aes_block *_iv, uint32_t blocks);
+void aes_ni_gen_ctr256(aes_block *out, aes_key *key, aes_block *_iv, uint32_t blocks);
 void aes_ni_encrypt_xts128(aes_block *out, aes_key *key1, aes_key *key2,
                            aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks);
+void aes_ni_encrypt_xts192(aes_block *out, aes_key *key1, aes_key *key2,
+                           aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks);
 void aes_ni_encrypt_xts256(aes_block *out, aes_key *key1, aes_key *key2,
                            aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks);
+void aes_ni_decrypt_xts128(aes_block *out, aes_key *key1, aes_key *key2,
+                           aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks);
+void aes_ni_decrypt_xts192(aes_block *out, aes_key *key1, aes_key *key2,
+                           aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks);
+void aes_ni_decrypt_xts256(aes_block *out, aes_key *key1, aes_key *key2,
+                           aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks);
 
 void aes_ni_gcm_encrypt128(uint8_t *out, aes_gcm *gcm, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_gcm_encrypt192(uint8_t *out, aes_gcm *gcm, aes_key *key, uint8_t *in, uint32_t length);
 void aes_ni_gcm_encrypt256(uint8_t *out, aes_gcm *gcm, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_gcm_decrypt128(uint8_t *out, aes_gcm *gcm, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_gcm_decrypt192(uint8_t *out, aes_gcm *gcm, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_gcm_decrypt256(uint8_t *out, aes_gcm *gcm, aes_key *key, uint8_t *in, uint32_t length);
+
+void aes_ni_ocb_encrypt128(uint8_t *out, aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_ocb_encrypt192(uint8_t *out, aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_ocb_encrypt256(uint8_t *out, aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_ocb_decrypt128(uint8_t *out, aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_ocb_decrypt192(uint8_t *out, aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_ocb_decrypt256(uint8_t *out, aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_ocb_aad128(aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_ocb_aad192(aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
+void aes_ni_ocb_aad256(aes_ocb *ocb, aes_key *key, uint8_t *in, uint32_t length);
 
-void gf_mul_x86ni(block128 *res, block128 *a_, block128 *b_);
+void gf_ghash_init_x86ni(block128 *htable, block128 *h);
+void gf_ghash_mul_x86ni(block128 *a, block128 *htable);
+void gf_ghash_blocks_x86ni(block128 *tag, block128 *htable, uint8_t *input, uint32_t nb_blocks);
 
 #endif
 
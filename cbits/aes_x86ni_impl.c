@@ -49,8 +49,20 @@ void SIZED(aes_ni_decrypt_block)(aes_block *out, aes_key *key, aes_block *in)
 void SIZED(aes_ni_encrypt_ecb)(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks)
 {
 	__m128i *k = (__m128i *) key->data;
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
 
 	PRELOAD_ENC(k);
+	for (; blocks >= 8; blocks -= 8, in += 8, out += 8) {
+		LOAD8(in);
+		DO_ENC_BLOCK8;
+		STORE8(out);
+	}
+	if (blocks >= 4) {
+		LOAD4(in);
+		DO_ENC_BLOCK4;
+		STORE4(out);
+		blocks -= 4; in += 4; out += 4;
+	}
 	for (; blocks-- > 0; in += 1, out += 1) {
 		__m128i m = _mm_loadu_si128((__m128i *) in);
 		DO_ENC_BLOCK(m);
@@ -61,9 +73,21 @@ void SIZED(aes_ni_encrypt_ecb)(aes_block *out, aes_key *key, aes_block *in, uint
 void SIZED(aes_ni_decrypt_ecb)(aes_block *out, aes_key *key, aes_block *in, uint32_t blocks)
 {
 	__m128i *k = (__m128i *) key->data;
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
 
 	PRELOAD_DEC(k);
 
+	for (; blocks >= 8; blocks -= 8, in += 8, out += 8) {
+		LOAD8(in);
+		DO_DEC_BLOCK8;
+		STORE8(out);
+	}
+	if (blocks >= 4) {
+		LOAD4(in);
+		DO_DEC_BLOCK4;
+		STORE4(out);
+		blocks -= 4; in += 4; out += 4;
+	}
 	for (; blocks-- > 0; in += 1, out += 1) {
 		__m128i m = _mm_loadu_si128((__m128i *) in);
 		DO_DEC_BLOCK(m);
@@ -87,13 +111,155 @@ void SIZED(aes_ni_encrypt_cbc)(aes_block *out, aes_key *key, aes_block *_iv, aes
 	}
 }
 
+/* cbc encryption of 4 (or 8) independent streams with keys of the same size:
+ * one block of each stream goes through the aes rounds together, so the chains
+ * fill the aes unit pipeline like ecb does. the keys differ for each stream
+ * so they are loaded from memory at each round instead of preloaded. */
+#define CBC_LANE_START(j) \
+	m##j = _mm_xor_si128(_mm_loadu_si128((__m128i *) (in[j] + i)), iv##j); \
+	m##j = _mm_xor_si128(m##j, _mm_loadu_si128(k##j));
+#define CBC_LANE_ROUND(j) \
+	m##j = _mm_aesenc_si128(m##j, _mm_loadu_si128(k##j + r));
+#define CBC_LANE_END(j) \
+	iv##j = _mm_aesenclast_si128(m##j, _mm_loadu_si128(k##j + NB_ROUNDS)); \
+	_mm_storeu_si128((__m128i *) (out[j] + i), iv##j);
+
+void SIZED(aes_ni_encrypt_cbc4)(aes_block **out, aes_key **keys, aes_block *ivs, aes_block **in, uint32_t blocks)
+{
+	__m128i *k0 = (__m128i *) keys[0]->data, *k1 = (__m128i *) keys[1]->data;
+	__m128i *k2 = (__m128i *) keys[2]->data, *k3 = (__m128i *) keys[3]->data;
+	__m128i iv0 = _mm_loadu_si128((__m128i *) &ivs[0]);
+	__m128i iv1 = _mm_loadu_si128((__m128i *) &ivs[1]);
+	__m128i iv2 = _mm_loadu_si128((__m128i *) &ivs[2]);
+	__m128i iv3 = _mm_loadu_si128((__m128i *) &ivs[3]);
+	__m128i m0, m1, m2, m3;
+	uint32_t i;
+	int r;
+
+	for (i = 0; i < blocks; i++) {
+		CBC_LANE_START(0) CBC_LANE_START(1) CBC_LANE_START(2) CBC_LANE_START(3)
+		for (r = 1; r < NB_ROUNDS; r++) {
+			CBC_LANE_ROUND(0) CBC_LANE_ROUND(1) CBC_LANE_ROUND(2) CBC_LANE_ROUND(3)
+		}
+		CBC_LANE_END(0) CBC_LANE_END(1) CBC_LANE_END(2) CBC_LANE_END(3)
+	}
+	_mm_storeu_si128((__m128i *) &ivs[0], iv0);
+	_mm_storeu_si128((__m128i *) &ivs[1], iv1);
+	_mm_storeu_si128((__m128i *) &ivs[2], iv2);
+	_mm_storeu_si128((__m128i *) &ivs[3], iv3);
+}
+
+void SIZED(aes_ni_encrypt_cbc8)(aes_block **out, aes_key **keys, aes_block *ivs, aes_block **in, uint32_t blocks)
+{
+	__m128i *k0 = (__m128i *) keys[0]->data, *k1 = (__m128i *) keys[1]->data;
+	__m128i *k2 = (__m128i *) keys[2]->data, *k3 = (__m128i *) keys[3]->data;
+	__m128i *k4 = (__m128i *) keys[4]->data, *k5 = (__m128i *) keys[5]->data;
+	__m128i *k6 = (__m128i *) keys[6]->data, *k7 = (__m128i *) keys[7]->data;
+	__m128i iv0 = _mm_loadu_si128((__m128i *) &ivs[0]);
+	__m128i iv1 = _mm_loadu_si128((__m128i *) &ivs[1]);
+	__m128i iv2 = _mm_loadu_si128((__m128i *) &ivs[2]);
+	__m128i iv3 = _mm_loadu_si128((__m128i *) &ivs[3]);
+	__m128i iv4 = _mm_loadu_si128((__m128i *) &ivs[4]);
+	__m128i iv5 = _mm_loadu_si128((__m128i *) &ivs[5]);
+	__m128i iv6 = _mm_loadu_si128((__m128i *) &ivs[6]);
+	__m128i iv7 = _mm_loadu_si128((__m128i *) &ivs[7]);
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	uint32_t i;
+	int r;
+
+	for (i = 0; i < blocks; i++) {
+		CBC_LANE_START(0) CBC_LANE_START(1) CBC_LANE_START(2) CBC_LANE_START(3)
+		CBC_LANE_START(4) CBC_LANE_START(5) CBC_LANE_START(6) CBC_LANE_START(7)
+		for (r = 1; r < NB_ROUNDS; r++) {
+			CBC_LANE_ROUND(0) CBC_LANE_ROUND(1) CBC_LANE_ROUND(2) CBC_LANE_ROUND(3)
+			CBC_LANE_ROUND(4) CBC_LANE_ROUND(5) CBC_LANE_ROUND(6) CBC_LANE_ROUND(7)
+		}
+		CBC_LANE_END(0) CBC_LANE_END(1) CBC_LANE_END(2) CBC_LANE_END(3)
+		CBC_LANE_END(4) CBC_LANE_END(5) CBC_LANE_END(6) CBC_LANE_END(7)
+	}
+	_mm_storeu_si128((__m128i *) &ivs[0], iv0);
+	_mm_storeu_si128((__m128i *) &ivs[1], iv1);
+	_mm_storeu_si128((__m128i *) &ivs[2], iv2);
+	_mm_storeu_si128((__m128i *) &ivs[3], iv3);
+	_mm_storeu_si128((__m128i *) &ivs[4], iv4);
+	_mm_storeu_si128((__m128i *) &ivs[5], iv5);
+	_mm_storeu_si128((__m128i *) &ivs[6], iv6);
+	_mm_storeu_si128((__m128i *) &ivs[7], iv7);
+}
+
+#undef CBC_LANE_START
+#undef CBC_LANE_ROUND
+#undef CBC_LANE_END
+
+/* encrypt 8 consecutive blocks, each with its own key of this size, in parallel */
+#define KEY_LANE_START(j) \
+	__m128i *k##j = (__m128i *) keys[j]->data; \
+	__m128i m##j = _mm_loadu_si128((__m128i *) &in[j]); \
+	m##j = _mm_xor_si128(m##j, _mm_loadu_si128(k##j));
+#define KEY_LANE_ROUND(j) \
+	m##j = _mm_aesenc_si128(m##j, _mm_loadu_si128(k##j + r));
+#define KEY_LANE_END(j) \
+	m##j = _mm_aesenclast_si128(m##j, _mm_loadu_si128(k##j + NB_ROUNDS)); \
+	_mm_storeu_si128((__m128i *) &out[j], m##j);
+
+void SIZED(aes_ni_encrypt_block8)(aes_block *out, aes_key **keys, aes_block *in)
+{
+	int r;
+
+	KEY_LANE_START(0) KEY_LANE_START(1) KEY_LANE_START(2) KEY_LANE_START(3)
+	KEY_LANE_START(4) KEY_LANE_START(5) KEY_LANE_START(6) KEY_LANE_START(7)
+	for (r = 1; r < NB_ROUNDS; r++) {
+		KEY_LANE_ROUND(0) KEY_LANE_ROUND(1) KEY_LANE_ROUND(2) KEY_LANE_ROUND(3)
+		KEY_LANE_ROUND(4) KEY_LANE_ROUND(5) KEY_LANE_ROUND(6) KEY_LANE_ROUND(7)
+	}
+	KEY_LANE_END(0) KEY_LANE_END(1) KEY_LANE_END(2) KEY_LANE_END(3)
+	KEY_LANE_END(4) KEY_LANE_END(5) KEY_LANE_END(6) KEY_LANE_END(7)
+}
+
+#undef KEY_LANE_START
+#undef KEY_LANE_ROUND
+#undef KEY_LANE_END
+
 void SIZED(aes_ni_decrypt_cbc)(aes_block *out, aes_key *key, aes_block *_iv, aes_block *in, uint32_t blocks)
 {
 	__m128i *k = (__m128i *) key->data;
 	__m128i iv = _mm_loadu_si128((__m128i *) _iv);
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
 
 	PRELOAD_DEC(k);
 
+	/* the ciphertext blocks are all loaded before any output is written,
+	 * so that decrypting in place is possible */
+	for (; blocks >= 8; blocks -= 8, in += 8, out += 8) {
+		__m128i c0, c1, c2, c3, c4, c5, c6, c7;
+		LOAD8(in);
+		c0 = m0; c1 = m1; c2 = m2; c3 = m3;
+		c4 = m4; c5 = m5; c6 = m6; c7 = m7;
+		DO_DEC_BLOCK8;
+		m0 = _mm_xor_si128(m0, iv);
+		m1 = _mm_xor_si128(m1, c0);
+		m2 = _mm_xor_si128(m2, c1);
+		m3 = _mm_xor_si128(m3, c2);
+		m4 = _mm_xor_si128(m4, c3);
+		m5 = _mm_xor_si128(m5, c4);
+		m6 = _mm_xor_si128(m6, c5);
+		m7 = _mm_xor_si128(m7, c6);
+		iv = c7;
+		STORE8(out);
+	}
+	if (blocks >= 4) {
+		__m128i c0, c1, c2, c3;
+		LOAD4(in);
+		c0 = m0; c1 = m1; c2 = m2; c3 = m3;
+		DO_DEC_BLOCK4;
+		m0 = _mm_xor_si128(m0, iv);
+		m1 = _mm_xor_si128(m1, c0);
+		m2 = _mm_xor_si128(m2, c1);
+		m3 = _mm_xor_si128(m3, c2);
+		iv = c3;
+		STORE4(out);
+		blocks -= 4; in += 4; out += 4;
+	}
 	for (; blocks-- > 0; in += 1, out += 1) {
 		__m128i m = _mm_loadu_si128((__m128i *) in);
 		__m128i ivnext = m;
@@ -111,8 +277,13 @@ void SIZED(aes_ni_encrypt_ctr)(uint8_t *output, aes_key *key, aes_block *_iv, ui
 	__m128i *k = (__m128i *) key->data;
 	__m128i bswap_mask = _mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
 	__m128i one        = _mm_set_epi32(0,1,0,0);
+	__m128i two        = _mm_set_epi32(0,2,0,0);
+	__m128i four       = _mm_set_epi32(0,4,0,0);
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
 	uint32_t nb_blocks = len / 16;
 	uint32_t part_block_len = len % 16;
+	/* low 64 bits of the counter */
+	uint64_t lo = be64_to_cpu(_iv->q[1]);
 
 	/* get the IV in little endian format */
 	__m128i iv = _mm_loadu_si128((__m128i *) _iv);
@@ -120,6 +291,57 @@ void SIZED(aes_ni_encrypt_ctr)(uint8_t *output, aes_key *key, aes_block *_iv, ui
 
 	PRELOAD_ENC(k);
 
+	for (; nb_blocks >= 8; nb_blocks -= 8, output += 16*8, input += 16*8) {
+		/* make 8 consecutive counters in big endian mode. when the low
+		 * 64 bits can't wrap in this batch, the counters are independent
+		 * additions instead of a chain of ctr_inc */
+		if (lo <= UINT64_MAX - 8) {
+			m0 = iv;
+			m1 = _mm_add_epi64(iv, one);
+			m2 = _mm_add_epi64(iv, two);
+			m3 = _mm_add_epi64(m1, two);
+			m4 = _mm_add_epi64(iv, four);
+			m5 = _mm_add_epi64(m1, four);
+			m6 = _mm_add_epi64(m2, four);
+			m7 = _mm_add_epi64(m3, four);
+			iv = _mm_add_epi64(m4, four);
+		} else {
+			m0 = iv;
+			m1 = iv = ctr_inc(iv, one);
+			m2 = iv = ctr_inc(iv, one);
+			m3 = iv = ctr_inc(iv, one);
+			m4 = iv = ctr_inc(iv, one);
+			m5 = iv = ctr_inc(iv, one);
+			m6 = iv = ctr_inc(iv, one);
+			m7 = iv = ctr_inc(iv, one);
+			iv = ctr_inc(iv, one);
+		}
+		lo += 8;
+		OP8(_mm_shuffle_epi8, bswap_mask);
+		DO_ENC_BLOCK8;
+		m0 = _mm_xor_si128(m0, _mm_loadu_si128(((__m128i *) input)+0));
+		m1 = _mm_xor_si128(m1, _mm_loadu_si128(((__m128i *) input)+1));
+		m2 = _mm_xor_si128(m2, _mm_loadu_si128(((__m128i *) input)+2));
+		m3 = _mm_xor_si128(m3, _mm_loadu_si128(((__m128i *) input)+3));
+		m4 = _mm_xor_si128(m4, _mm_loadu_si128(((__m128i *) input)+4));
+		m5 = _mm_xor_si128(m5, _mm_loadu_si128(((__m128i *) input)+5));
+		m6 = _mm_xor_si128(m6, _mm_loadu_si128(((__m128i *) input)+6));
+		m7 = _mm_xor_si128(m7, _mm_loadu_si128(((__m128i *) input)+7));
+		STORE8(output);
+	}
+	if (nb_blocks >= 4) {
+		m0 = _mm_shuffle_epi8(iv, bswap_mask); iv = ctr_inc(iv, one);
+		m1 = _mm_shuffle_epi8(iv, bswap_mask); iv = ctr_inc(iv, one);
+		m2 = _mm_shuffle_epi8(iv, bswap_mask); iv = ctr_inc(iv, one);
+		m3 = _mm_shuffle_epi8(iv, bswap_mask); iv = ctr_inc(iv, one);
+		DO_ENC_BLOCK4;
+		m0 = _mm_xor_si128(m0, _mm_loadu_si128(((__m128i *) input)+0));
+		m1 = _mm_xor_si128(m1, _mm_loadu_si128(((__m128i *) input)+1));
+		m2 = _mm_xor_si128(m2, _mm_loadu_si128(((__m128i *) input)+2));
+		m3 = _mm_xor_si128(m3, _mm_loadu_si128(((__m128i *) input)+3));
+		STORE4(output);
+		nb_blocks -= 4; output += 16*4; input += 16*4;
+	}
 	for (; nb_blocks-- > 0; output += 16, input += 16) {
 		/* put back the iv in big endian mode,
 		 * encrypt it and and xor it the input block
@@ -131,7 +353,7 @@ void SIZED(aes_ni_encrypt_ctr)(uint8_t *output, aes_key *key, aes_block *_iv, ui
 
 		_mm_storeu_si128((__m128i *) output, m);
 		/* iv += 1 */
-		iv = _mm_add_epi64(iv, one);
+		iv = ctr_inc(iv, one);
 	}
 
 	if (part_block_len != 0) {
@@ -151,24 +373,122 @@ void SIZED(aes_ni_encrypt_ctr)(uint8_t *output, aes_key *key, aes_block *_iv, ui
 	return ;
 }
 
+/* counter mode keystream: encrypt nb_blocks consecutive counters from _iv,
+ * and leave _iv on the counter following the last one */
+void SIZED(aes_ni_gen_ctr)(aes_block *out, aes_key *key, aes_block *_iv, uint32_t blocks)
+{
+	__m128i *k = (__m128i *) key->data;
+	__m128i bswap_mask = _mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+	__m128i one        = _mm_set_epi32(0,1,0,0);
+	__m128i two        = _mm_set_epi32(0,2,0,0);
+	__m128i four       = _mm_set_epi32(0,4,0,0);
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	uint64_t lo = be64_to_cpu(_iv->q[1]);
+
+	__m128i iv = _mm_loadu_si128((__m128i *) _iv);
+	iv = _mm_shuffle_epi8(iv, bswap_mask);
+
+	PRELOAD_ENC(k);
+
+	for (; blocks >= 8; blocks -= 8, out += 8) {
+		if (lo <= UINT64_MAX - 8) {
+			m0 = iv;
+			m1 = _mm_add_epi64(iv, one);
+			m2 = _mm_add_epi64(iv, two);
+			m3 = _mm_add_epi64(m1, two);
+			m4 = _mm_add_epi64(iv, four);
+			m5 = _mm_add_epi64(m1, four);
+			m6 = _mm_add_epi64(m2, four);
+			m7 = _mm_add_epi64(m3, four);
+			iv = _mm_add_epi64(m4, four);
+		} else {
+			m0 = iv;
+			m1 = iv = ctr_inc(iv, one);
+			m2 = iv = ctr_inc(iv, one);
+			m3 = iv = ctr_inc(iv, one);
+			m4 = iv = ctr_inc(iv, one);
+			m5 = iv = ctr_inc(iv, one);
+			m6 = iv = ctr_inc(iv, one);
+			m7 = iv = ctr_inc(iv, one);
+			iv = ctr_inc(iv, one);
+		}
+		lo += 8;
+		OP8(_mm_shuffle_epi8, bswap_mask);
+		DO_ENC_BLOCK8;
+		STORE8(out);
+	}
+	if (blocks >= 4) {
+		m0 = _mm_shuffle_epi8(iv, bswap_mask); iv = ctr_inc(iv, one);
+		m1 = _mm_shuffle_epi8(iv, bswap_mask); iv = ctr_inc(iv, one);
+		m2 = _mm_shuffle_epi8(iv, bswap_mask); iv = ctr_inc(iv, one);
+		m3 = _mm_shuffle_epi8(iv, bswap_mask); iv = ctr_inc(iv, one);
+		DO_ENC_BLOCK4;
+		STORE4(out);
+		blocks -= 4; out += 4;
+	}
+	for (; blocks-- > 0; out++) {
+		__m128i tmp = _mm_shuffle_epi8(iv, bswap_mask);
+		DO_ENC_BLOCK(tmp);
+		_mm_storeu_si128((__m128i *) out, tmp);
+		iv = ctr_inc(iv, one);
+	}
+
+	_mm_storeu_si128((__m128i *) _iv, _mm_shuffle_epi8(iv, bswap_mask));
+}
+
 void SIZED(aes_ni_encrypt_xts)(aes_block *out, aes_key *key1, aes_key *key2,
                                aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks)
 {
 	__m128i tweak = _mm_loadu_si128((__m128i *) _tweak);
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	__m128i o0, o1, o2, o3, o4, o5, o6, o7;
 
 	do {
 		__m128i *k2 = (__m128i *) key2->data;
 		PRELOAD_ENC(k2);
 		DO_ENC_BLOCK(tweak);
 
-		while (spoint-- > 0)
-			tweak = gfmulx(tweak);
+		if (spoint > 0) {
+			aes_block t;
+			_mm_storeu_si128((__m128i *) &t, tweak);
+			gf_mulx_pow(&t, spoint);
+			tweak = _mm_loadu_si128((__m128i *) &t);
+		}
 	} while (0) ;
 
 	do {
 		__m128i *k1 = (__m128i *) key1->data;
 		PRELOAD_ENC(k1);
 
+		for ( ; blocks >= 8; blocks -= 8, in += 8, out += 8) {
+			o0 = tweak;
+			o1 = gfmulx(o0);
+			o2 = gfmulx(o1);
+			o3 = gfmulx(o2);
+			o4 = gfmulx(o3);
+			o5 = gfmulx(o4);
+			o6 = gfmulx(o5);
+			o7 = gfmulx(o6);
+			tweak = gfmulx(o7);
+			LOAD8(in);
+			XOR_O8;
+			DO_ENC_BLOCK8;
+			XOR_O8;
+			STORE8(out);
+		}
+		if (blocks >= 4) {
+			o0 = tweak;
+			o1 = gfmulx(o0);
+			o2 = gfmulx(o1);
+			o3 = gfmulx(o2);
+			tweak = gfmulx(o3);
+			LOAD4(in);
+			XOR_O4;
+			DO_ENC_BLOCK4;
+			XOR_O4;
+			STORE4(out);
+			blocks -= 4; in += 4; out += 4;
+		}
 		for ( ; blocks-- > 0; in += 1, out += 1, tweak = gfmulx(tweak)) {
 			__m128i m = _mm_loadu_si128((__m128i *) in);
 
@@ -181,26 +501,119 @@ void SIZED(aes_ni_encrypt_xts)(aes_block *out, aes_key *key1, aes_key *key2,
 	} while (0);
 }
 
+void SIZED(aes_ni_decrypt_xts)(aes_block *out, aes_key *key1, aes_key *key2,
+                               aes_block *_tweak, uint32_t spoint, aes_block *in, uint32_t blocks)
+{
+	__m128i tweak = _mm_loadu_si128((__m128i *) _tweak);
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	__m128i o0, o1, o2, o3, o4, o5, o6, o7;
+
+	do {
+		__m128i *k2 = (__m128i *) key2->data;
+		PRELOAD_ENC(k2);
+		DO_ENC_BLOCK(tweak);
+
+		if (spoint > 0) {
+			aes_block t;
+			_mm_storeu_si128((__m128i *) &t, tweak);
+			gf_mulx_pow(&t, spoint);
+			tweak = _mm_loadu_si128((__m128i *) &t);
+		}
+	} while (0) ;
+
+	do {
+		__m128i *k1 = (__m128i *) key1->data;
+		PRELOAD_DEC(k1);
+
+		for ( ; blocks >= 8; blocks -= 8, in += 8, out += 8) {
+			o0 = tweak;
+			o1 = gfmulx(o0);
+			o2 = gfmulx(o1);
+			o3 = gfmulx(o2);
+			o4 = gfmulx(o3);
+			o5 = gfmulx(o4);
+			o6 = gfmulx(o5);
+			o7 = gfmulx(o6);
+			tweak = gfmulx(o7);
+			LOAD8(in);
+			XOR_O8;
+			DO_DEC_BLOCK8;
+			XOR_O8;
+			STORE8(out);
+		}
+		if (blocks >= 4) {
+			o0 = tweak;
+			o1 = gfmulx(o0);
+			o2 = gfmulx(o1);
+			o3 = gfmulx(o2);
+			tweak = gfmulx(o3);
+			LOAD4(in);
+			XOR_O4;
+			DO_DEC_BLOCK4;
+			XOR_O4;
+			STORE4(out);
+			blocks -= 4; in += 4; out += 4;
+		}
+		for ( ; blocks-- > 0; in += 1, out += 1, tweak = gfmulx(tweak)) {
+			__m128i m = _mm_loadu_si128((__m128i *) in);
+
+			m = _mm_xor_si128(m, tweak);
+			DO_DEC_BLOCK(m);
+			m = _mm_xor_si128(m, tweak);
+
+			_mm_storeu_si128((__m128i *) out, m);
+		}
+	} while (0);
+}
+
 void SIZED(aes_ni_gcm_encrypt)(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length)
 {
 	__m128i *k = (__m128i *) key->data;
 	__m128i bswap_mask = _mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+	__m128i ghash_mask = _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
 	__m128i one        = _mm_set_epi32(0,1,0,0);
 	uint32_t nb_blocks = length / 16;
 	uint32_t part_block_len = length % 16;
+	uint8_t *pending = NULL;
 
 	gcm->length_input += length;
 
-	__m128i h  = _mm_loadu_si128((__m128i *) &gcm->h);
+	/* tag and h are kept byte-reflected for the whole loop, the powers
+	 * of h in htable are already stored that way */
+	__m128i h  = _mm_loadu_si128((__m128i *) &gcm->htable[0]);
 	__m128i tag = _mm_loadu_si128((__m128i *) &gcm->tag);
+	tag = _mm_shuffle_epi8(tag, ghash_mask);
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
 	__m128i iv = _mm_loadu_si128((__m128i *) &gcm->civ);
 	iv = _mm_shuffle_epi8(iv, bswap_mask);
 
 	PRELOAD_ENC(k);
 
+	/* the ciphertext of a batch of 8 blocks is only hashed while the next
+	 * batch goes through the aes rounds, so that both are independent
+	 * and can run in parallel. the last batch is hashed after the loop */
+	for (; nb_blocks >= 8; nb_blocks -= 8, output += 16*8, input += 16*8) {
+		if (pending)
+			tag = ghash_add8(tag, gcm->htable, pending);
+		m0 = iv = ctr_inc(iv, one);
+		m1 = iv = ctr_inc(iv, one);
+		m2 = iv = ctr_inc(iv, one);
+		m3 = iv = ctr_inc(iv, one);
+		m4 = iv = ctr_inc(iv, one);
+		m5 = iv = ctr_inc(iv, one);
+		m6 = iv = ctr_inc(iv, one);
+		m7 = iv = ctr_inc(iv, one);
+		OP8(_mm_shuffle_epi8, bswap_mask);
+		DO_ENC_BLOCK8;
+		XOR_IN8(input);
+		STORE8(output);
+		pending = output;
+	}
+	if (pending)
+		tag = ghash_add8(tag, gcm->htable, pending);
 	for (; nb_blocks-- > 0; output += 16, input += 16) {
 		/* iv += 1 */
-		iv = _mm_add_epi64(iv, one);
+		iv = ctr_inc(iv, one);
 
 		/* put back iv in big endian, encrypt it,
 		 * and xor it to input */
@@ -209,7 +622,7 @@ void SIZED(aes_ni_gcm_encrypt)(uint8_t *output, aes_gcm *gcm, aes_key *key, uint
 		__m128i m = _mm_loadu_si128((__m128i *) input);
 		m = _mm_xor_si128(m, tmp);
 
-		tag = ghash_add(tag, h, m);
+		tag = ghash_add(tag, h, _mm_shuffle_epi8(m, ghash_mask));
 
 		/* store it out */
 		_mm_storeu_si128((__m128i *) output, m);
@@ -240,7 +653,7 @@ void SIZED(aes_ni_gcm_encrypt)(uint8_t *output, aes_gcm *gcm, aes_key *key, uint
 		block128_copy_bytes(&block, input, part_block_len);
 
 		/* iv += 1 */
-		iv = _mm_add_epi64(iv, one);
+		iv = ctr_inc(iv, one);
 
 		/* put back iv in big endian mode, encrypt it and xor it with input */
 		__m128i tmp = _mm_shuffle_epi8(iv, bswap_mask);
@@ -250,7 +663,92 @@ void SIZED(aes_ni_gcm_encrypt)(uint8_t *output, aes_gcm *gcm, aes_key *key, uint
 		m = _mm_xor_si128(m, tmp);
 		m = _mm_shuffle_epi8(m, mask);
 
-		tag = ghash_add(tag, h, m);
+		tag = ghash_add(tag, h, _mm_shuffle_epi8(m, ghash_mask));
+
+		/* make output */
+		_mm_storeu_si128((__m128i *) &block.b, m);
+		memcpy(output, &block.b, part_block_len);
+	}
+	/* store back IV & tag */
+	__m128i tmp = _mm_shuffle_epi8(iv, bswap_mask);
+	_mm_storeu_si128((__m128i *) &gcm->civ, tmp);
+	tag = _mm_shuffle_epi8(tag, ghash_mask);
+	_mm_storeu_si128((__m128i *) &gcm->tag, tag);
+}
+
+void SIZED(aes_ni_gcm_decrypt)(uint8_t *output, aes_gcm *gcm, aes_key *key, uint8_t *input, uint32_t length)
+{
+	__m128i *k = (__m128i *) key->data;
+	__m128i bswap_mask = _mm_setr_epi8(7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8);
+	__m128i ghash_mask = _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+	__m128i one        = _mm_set_epi32(0,1,0,0);
+	uint32_t nb_blocks = length / 16;
+	uint32_t part_block_len = length % 16;
+
+	gcm->length_input += length;
+
+	/* tag and h are kept byte-reflected for the whole loop, the powers
+	 * of h in htable are already stored that way */
+	__m128i h  = _mm_loadu_si128((__m128i *) &gcm->htable[0]);
+	__m128i tag = _mm_loadu_si128((__m128i *) &gcm->tag);
+	tag = _mm_shuffle_epi8(tag, ghash_mask);
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	__m128i iv = _mm_loadu_si128((__m128i *) &gcm->civ);
+	iv = _mm_shuffle_epi8(iv, bswap_mask);
+
+	PRELOAD_ENC(k);
+
+	/* the input is the ciphertext, so the 8 blocks can be hashed
+	 * at the same time they are decrypted */
+	for (; nb_blocks >= 8; nb_blocks -= 8, output += 16*8, input += 16*8) {
+		tag = ghash_add8(tag, gcm->htable, input);
+		m0 = iv = ctr_inc(iv, one);
+		m1 = iv = ctr_inc(iv, one);
+		m2 = iv = ctr_inc(iv, one);
+		m3 = iv = ctr_inc(iv, one);
+		m4 = iv = ctr_inc(iv, one);
+		m5 = iv = ctr_inc(iv, one);
+		m6 = iv = ctr_inc(iv, one);
+		m7 = iv = ctr_inc(iv, one);
+		OP8(_mm_shuffle_epi8, bswap_mask);
+		DO_ENC_BLOCK8;
+		XOR_IN8(input);
+		STORE8(output);
+	}
+	for (; nb_blocks-- > 0; output += 16, input += 16) {
+		/* iv += 1 */
+		iv = ctr_inc(iv, one);
+
+		/* the tag is computed over the ciphertext, which is the input here */
+		__m128i m = _mm_loadu_si128((__m128i *) input);
+		tag = ghash_add(tag, h, _mm_shuffle_epi8(m, ghash_mask));
+
+		/* put back iv in big endian, encrypt it,
+		 * and xor it to input */
+		__m128i tmp = _mm_shuffle_epi8(iv, bswap_mask);
+		DO_ENC_BLOCK(tmp);
+		m = _mm_xor_si128(m, tmp);
+
+		/* store it out */
+		_mm_storeu_si128((__m128i *) output, m);
+	}
+	if (part_block_len > 0) {
+		aes_block block;
+
+		/* the zero padded ciphertext is what get hashed, so no need to mask */
+		block128_zero(&block);
+		block128_copy_bytes(&block, input, part_block_len);
+
+		/* iv += 1 */
+		iv = ctr_inc(iv, one);
+
+		__m128i m = _mm_loadu_si128((__m128i *) &block);
+		tag = ghash_add(tag, h, _mm_shuffle_epi8(m, ghash_mask));
+
+		/* put back iv in big endian mode, encrypt it and xor it with input */
+		__m128i tmp = _mm_shuffle_epi8(iv, bswap_mask);
+		DO_ENC_BLOCK(tmp);
+		m = _mm_xor_si128(m, tmp);
 
 		/* make output */
 		_mm_storeu_si128((__m128i *) &block.b, m);
@@ -259,5 +757,245 @@ void SIZED(aes_ni_gcm_encrypt)(uint8_t *output, aes_gcm *gcm, aes_key *key, uint
 	/* store back IV & tag */
 	__m128i tmp = _mm_shuffle_epi8(iv, bswap_mask);
 	_mm_storeu_si128((__m128i *) &gcm->civ, tmp);
+	tag = _mm_shuffle_epi8(tag, ghash_mask);
 	_mm_storeu_si128((__m128i *) &gcm->tag, tag);
 }
+
+/* offsets are computed 8 (or 4) blocks at a time, then the 8 (or 4) blocks go
+ * through the aes rounds together. the block index carries on from the
+ * previous call, so single blocks are done first until it reaches a
+ * multiple of 8, where the batches expect to start */
+void SIZED(aes_ni_ocb_encrypt)(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length)
+{
+	__m128i *k = (__m128i *) key->data;
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	__m128i o0, o1, o2, o3, o4, o5, o6, o7;
+	__m128i l0 = _mm_loadu_si128((__m128i *) &ocb->li[0]);
+	__m128i l1 = _mm_loadu_si128((__m128i *) &ocb->li[1]);
+	__m128i l2 = _mm_loadu_si128((__m128i *) &ocb->li[2]);
+	__m128i offset = _mm_loadu_si128((__m128i *) &ocb->offset_enc);
+	__m128i sum = _mm_loadu_si128((__m128i *) &ocb->sum_enc);
+	uint32_t nb_blocks = length / 16;
+	uint32_t part_block_len = length % 16;
+	unsigned int i = ocb->blocks_enc;
+	block128 tmp;
+
+	PRELOAD_ENC(k);
+
+	for (; nb_blocks > 0 && (i % 8) != 0; nb_blocks--, input += 16, output += 16) {
+		ocb_get_L_i(&tmp, ocb->li, ++i);
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &tmp));
+
+		__m128i m = _mm_loadu_si128((__m128i *) input);
+		sum = _mm_xor_si128(sum, m);
+		m = _mm_xor_si128(m, offset);
+		DO_ENC_BLOCK(m);
+		m = _mm_xor_si128(m, offset);
+		_mm_storeu_si128((__m128i *) output, m);
+	}
+	for (; nb_blocks >= 8; nb_blocks -= 8, i += 8, input += 16*8, output += 16*8) {
+		ocb_get_L_i(&tmp, ocb->li, i + 8);
+		OCB_OFFSETS8(offset, _mm_loadu_si128((__m128i *) &tmp));
+		offset = o7;
+		LOAD8(input);
+		SUM8(sum);
+		XOR_O8;
+		DO_ENC_BLOCK8;
+		XOR_O8;
+		STORE8(output);
+	}
+	if (nb_blocks >= 4) {
+		OCB_OFFSETS4(offset);
+		offset = o3;
+		LOAD4(input);
+		SUM4(sum);
+		XOR_O4;
+		DO_ENC_BLOCK4;
+		XOR_O4;
+		STORE4(output);
+		nb_blocks -= 4; i += 4; input += 16*4; output += 16*4;
+	}
+	for (; nb_blocks-- > 0; input += 16, output += 16) {
+		/* Offset_i = Offset_{i-1} xor L_{ntz(i)} */
+		ocb_get_L_i(&tmp, ocb->li, ++i);
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &tmp));
+
+		__m128i m = _mm_loadu_si128((__m128i *) input);
+		sum = _mm_xor_si128(sum, m);
+		m = _mm_xor_si128(m, offset);
+		DO_ENC_BLOCK(m);
+		m = _mm_xor_si128(m, offset);
+		_mm_storeu_si128((__m128i *) output, m);
+	}
+
+	if (part_block_len > 0) {
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &ocb->lstar));
+		__m128i pad = offset;
+		DO_ENC_BLOCK(pad);
+
+		block128_zero(&tmp);
+		block128_copy_bytes(&tmp, input, part_block_len);
+		tmp.b[part_block_len] = 0x80;
+		__m128i m = _mm_loadu_si128((__m128i *) &tmp);
+		sum = _mm_xor_si128(sum, m);
+		m = _mm_xor_si128(m, pad);
+		_mm_storeu_si128((__m128i *) &tmp, m);
+		memcpy(output, tmp.b, part_block_len);
+	}
+	_mm_storeu_si128((__m128i *) &ocb->offset_enc, offset);
+	_mm_storeu_si128((__m128i *) &ocb->sum_enc, sum);
+	ocb->blocks_enc = i;
+}
+
+void SIZED(aes_ni_ocb_decrypt)(uint8_t *output, aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length)
+{
+	__m128i *k = (__m128i *) key->data;
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	__m128i o0, o1, o2, o3, o4, o5, o6, o7;
+	__m128i l0 = _mm_loadu_si128((__m128i *) &ocb->li[0]);
+	__m128i l1 = _mm_loadu_si128((__m128i *) &ocb->li[1]);
+	__m128i l2 = _mm_loadu_si128((__m128i *) &ocb->li[2]);
+	__m128i offset = _mm_loadu_si128((__m128i *) &ocb->offset_enc);
+	__m128i sum = _mm_loadu_si128((__m128i *) &ocb->sum_enc);
+	uint32_t nb_blocks = length / 16;
+	uint32_t part_block_len = length % 16;
+	unsigned int i = ocb->blocks_enc;
+	block128 tmp;
+
+	PRELOAD_DEC(k);
+
+	for (; nb_blocks > 0 && (i % 8) != 0; nb_blocks--, input += 16, output += 16) {
+		ocb_get_L_i(&tmp, ocb->li, ++i);
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &tmp));
+
+		__m128i m = _mm_loadu_si128((__m128i *) input);
+		m = _mm_xor_si128(m, offset);
+		DO_DEC_BLOCK(m);
+		m = _mm_xor_si128(m, offset);
+		sum = _mm_xor_si128(sum, m);
+		_mm_storeu_si128((__m128i *) output, m);
+	}
+	for (; nb_blocks >= 8; nb_blocks -= 8, i += 8, input += 16*8, output += 16*8) {
+		ocb_get_L_i(&tmp, ocb->li, i + 8);
+		OCB_OFFSETS8(offset, _mm_loadu_si128((__m128i *) &tmp));
+		offset = o7;
+		LOAD8(input);
+		XOR_O8;
+		DO_DEC_BLOCK8;
+		XOR_O8;
+		SUM8(sum);
+		STORE8(output);
+	}
+	if (nb_blocks >= 4) {
+		OCB_OFFSETS4(offset);
+		offset = o3;
+		LOAD4(input);
+		XOR_O4;
+		DO_DEC_BLOCK4;
+		XOR_O4;
+		SUM4(sum);
+		STORE4(output);
+		nb_blocks -= 4; i += 4; input += 16*4; output += 16*4;
+	}
+	for (; nb_blocks-- > 0; input += 16, output += 16) {
+		/* Offset_i = Offset_{i-1} xor L_{ntz(i)} */
+		ocb_get_L_i(&tmp, ocb->li, ++i);
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &tmp));
+
+		__m128i m = _mm_loadu_si128((__m128i *) input);
+		m = _mm_xor_si128(m, offset);
+		DO_DEC_BLOCK(m);
+		m = _mm_xor_si128(m, offset);
+		sum = _mm_xor_si128(sum, m);
+		_mm_storeu_si128((__m128i *) output, m);
+	}
+
+	if (part_block_len > 0) {
+		block128 pad;
+
+		/* the pad is an encryption, while the keys loaded are for decryption */
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &ocb->lstar));
+		_mm_storeu_si128((__m128i *) &pad, offset);
+		SIZED(aes_ni_encrypt_block)(&pad, key, &pad);
+
+		block128_zero(&tmp);
+		block128_copy_bytes(&tmp, input, part_block_len);
+		block128_xor_bytes(&tmp, pad.b, part_block_len);
+		tmp.b[part_block_len] = 0x80;
+		memcpy(output, tmp.b, part_block_len);
+		sum = _mm_xor_si128(sum, _mm_loadu_si128((__m128i *) &tmp));
+	}
+	_mm_storeu_si128((__m128i *) &ocb->offset_enc, offset);
+	_mm_storeu_si128((__m128i *) &ocb->sum_enc, sum);
+	ocb->blocks_enc = i;
+}
+
+void SIZED(aes_ni_ocb_aad)(aes_ocb *ocb, aes_key *key, uint8_t *input, uint32_t length)
+{
+	__m128i *k = (__m128i *) key->data;
+	__m128i m0, m1, m2, m3, m4, m5, m6, m7;
+	__m128i o0, o1, o2, o3, o4, o5, o6, o7;
+	__m128i l0 = _mm_loadu_si128((__m128i *) &ocb->li[0]);
+	__m128i l1 = _mm_loadu_si128((__m128i *) &ocb->li[1]);
+	__m128i l2 = _mm_loadu_si128((__m128i *) &ocb->li[2]);
+	__m128i offset = _mm_loadu_si128((__m128i *) &ocb->offset_aad);
+	__m128i sum = _mm_loadu_si128((__m128i *) &ocb->sum_aad);
+	uint32_t nb_blocks = length / 16;
+	uint32_t part_block_len = length % 16;
+	unsigned int i = ocb->blocks_aad;
+	block128 tmp;
+
+	PRELOAD_ENC(k);
+
+	for (; nb_blocks > 0 && (i % 8) != 0; nb_blocks--, input += 16) {
+		ocb_get_L_i(&tmp, ocb->li, ++i);
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &tmp));
+
+		__m128i m = _mm_loadu_si128((__m128i *) input);
+		m = _mm_xor_si128(m, offset);
+		DO_ENC_BLOCK(m);
+		sum = _mm_xor_si128(sum, m);
+	}
+	for (; nb_blocks >= 8; nb_blocks -= 8, i += 8, input += 16*8) {
+		ocb_get_L_i(&tmp, ocb->li, i + 8);
+		OCB_OFFSETS8(offset, _mm_loadu_si128((__m128i *) &tmp));
+		offset = o7;
+		LOAD8(input);
+		XOR_O8;
+		DO_ENC_BLOCK8;
+		SUM8(sum);
+	}
+	if (nb_blocks >= 4) {
+		OCB_OFFSETS4(offset);
+		offset = o3;
+		LOAD4(input);
+		XOR_O4;
+		DO_ENC_BLOCK4;
+		SUM4(sum);
+		nb_blocks -= 4; i += 4; input += 16*4;
+	}
+	for (; nb_blocks-- > 0; input += 16) {
+		ocb_get_L_i(&tmp, ocb->li, ++i);
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &tmp));
+
+		__m128i m = _mm_loadu_si128((__m128i *) input);
+		m = _mm_xor_si128(m, offset);
+		DO_ENC_BLOCK(m);
+		sum = _mm_xor_si128(sum, m);
+	}
+
+	if (part_block_len > 0) {
+		offset = _mm_xor_si128(offset, _mm_loadu_si128((__m128i *) &ocb->lstar));
+
+		block128_zero(&tmp);
+		block128_copy_bytes(&tmp, input, part_block_len);
+		tmp.b[part_block_len] = 0x80;
+		__m128i m = _mm_loadu_si128((__m128i *) &tmp);
+		m = _mm_xor_si128(m, offset);
+		DO_ENC_BLOCK(m);
+		sum = _mm_xor_si128(sum, m);
+	}
+	_mm_storeu_si128((__m128i *) &ocb->offset_aad, offset);
+	_mm_storeu_si128((__m128i *) &ocb->sum_aad, sum);
+	ocb->blocks_aad = i;
+}
@@ -84,6 +84,17 @@ static inline void block128_inc_be(block128 *b)
 		b->q[1] = cpu_to_be64(v);
 }
 
+/* add n to b, as a 128 bits big endian counter */
+static inline void block128_add_be(block128 *b, uint64_t n)
+{
+	uint64_t v = be64_to_cpu(b->q[1]);
+	uint64_t s = v + n;
+
+	if (s < v)
+		b->q[0] = cpu_to_be64(be64_to_cpu(b->q[0]) + 1);
+	b->q[1] = cpu_to_be64(s);
+}
+
 #ifdef IMPL_DEBUG
 #include <stdio.h>
 static inline void block128_print(block128 *b)
@@ -54,20 +54,31 @@ static void cpuid(uint32_t info, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, ui
 }
 
 #ifdef USE_AESNI
-void initialize_hw(void (*init_table)(int, int))
+void initialize_hw(void (*init_table)(int, int, int))
 {
 	static int inited = 0;
 	if (inited == 0) {
 		uint32_t eax, ebx, ecx, edx;
-		int aesni, pclmul;
+		int aesni, pclmul, ssse3;
 
 		inited = 1;
 		cpuid(1, &eax, &ebx, &ecx, &edx);
 		aesni = (ecx & 0x02000000);
 		pclmul = (ecx & 0x00000001);
-		init_table(aesni, pclmul);
+		ssse3 = (ecx & 0x00000200);
+		init_table(aesni, pclmul, ssse3);
 	}
 }
+
+/* call init_table again, with only the features that the cpu has and that
+ * are requested. used to test the implementations a cpu doesn't select. */
+void initialize_hw_with(void (*init_table)(int, int, int), int aesni, int pclmul, int ssse3)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid(1, &eax, &ebx, &ecx, &edx);
+	init_table(aesni && (ecx & 0x02000000), pclmul && (ecx & 0x00000001), ssse3 && (ecx & 0x00000200));
+}
 #else
 #define initialize_hw(init_table) 	(0)
 #endif
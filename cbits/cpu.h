@@ -37,9 +37,11 @@
 #endif
 
 #ifdef USE_AESNI
-void initialize_hw(void (*init_table)(int, int));
+void initialize_hw(void (*init_table)(int, int, int));
+void initialize_hw_with(void (*init_table)(int, int, int), int aesni, int pclmul, int ssse3);
 #else
 #define initialize_hw(init_table) 	(0)
+#define initialize_hw_with(init_table, aesni, pclmul, ssse3) 	(0)
 #endif
 
 #endif
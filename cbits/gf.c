@@ -34,31 +34,107 @@
 #include "gf.h"
 #include "aes_x86ni.h"
 
-/* this is a really inefficient way to GF multiply.
- * the alternative without hw accel is building small tables
- * to speed up the multiplication.
- * TODO: optimise with tables
+/* GHASH multiplication by a fixed H, using Shoup's 4 bits tables:
+ * htable[i] holds i * H, with i's 4 bits taken in GHASH's reflected order.
+ * each entry is kept as two native 64 bits words (high then low half of
+ * the big endian value), so nothing depends on the host byte order.
  */
-void gf_mul(block128 *a, block128 *b)
+void gf_ghash_init(block128 *htable, block128 *h)
 {
-	uint64_t a0, a1, v0, v1;
+	uint64_t vh, vl;
 	int i, j;
 
-	a0 = a1 = 0;
-	v0 = cpu_to_be64(a->q[0]);
-	v1 = cpu_to_be64(a->q[1]);
-
-	for (i = 0; i < 16; i++)
-		for (j = 0x80; j != 0; j >>= 1) {
-			uint8_t x = b->b[i] & j;
-			a0 ^= x ? v0 : 0;
-			a1 ^= x ? v1 : 0;
-			x = (uint8_t) v1 & 1;
-			v1 = (v1 >> 1) | (v0 << 63);
-			v0 = (v0 >> 1) ^ (x ? (0xe1ULL << 56) : 0);
+	vh = be64_to_cpu(h->q[0]);
+	vl = be64_to_cpu(h->q[1]);
+
+	htable[0].q[0] = 0;
+	htable[0].q[1] = 0;
+	htable[8].q[0] = vh;
+	htable[8].q[1] = vl;
+
+	/* 4, 2, 1 are H times x, x^2, x^3 */
+	for (i = 4; i > 0; i >>= 1) {
+		uint64_t r = (vl & 1) ? (0xe1ULL << 56) : 0;
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ r;
+		htable[i].q[0] = vh;
+		htable[i].q[1] = vl;
+	}
+	/* the other entries are linear combinations */
+	for (i = 2; i <= 8; i *= 2) {
+		for (j = 1; j < i; j++) {
+			htable[i+j].q[0] = htable[i].q[0] ^ htable[j].q[0];
+			htable[i+j].q[1] = htable[i].q[1] ^ htable[j].q[1];
 		}
-	a->q[0] = cpu_to_be64(a0);
-	a->q[1] = cpu_to_be64(a1);
+	}
+}
+
+/* reduction of the 4 bits shifted out at each step */
+static const uint64_t last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+};
+
+/* inplace a = a * H, with htable made by gf_ghash_init */
+void gf_ghash_mul(block128 *a, block128 *htable)
+{
+	uint64_t zh, zl;
+	uint8_t rem, n;
+	int i;
+
+	n = a->b[15] & 0xf;
+	zh = htable[n].q[0];
+	zl = htable[n].q[1];
+
+	for (i = 15; i >= 0; i--) {
+		if (i != 15) {
+			n = a->b[i] & 0xf;
+			rem = zl & 0xf;
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (last4[rem] << 48);
+			zh ^= htable[n].q[0];
+			zl ^= htable[n].q[1];
+		}
+		n = a->b[i] >> 4;
+		rem = zl & 0xf;
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (last4[rem] << 48);
+		zh ^= htable[n].q[0];
+		zl ^= htable[n].q[1];
+	}
+	a->q[0] = cpu_to_be64(zh);
+	a->q[1] = cpu_to_be64(zl);
+}
+
+/* hash nb_blocks full blocks of input into tag */
+void gf_ghash_blocks(block128 *tag, block128 *htable, uint8_t *input, uint32_t nb_blocks)
+{
+	for (; nb_blocks-- > 0; input += 16) {
+		block128_xor(tag, (block128 *) input);
+		gf_ghash_mul(tag, htable);
+	}
+}
+
+/* inplace a = a * b for any b, one bit at a time and without branches.
+ * much slower than gf_ghash_mul, for the few products not by a fixed H. */
+void gf_mul(block128 *a, block128 *b)
+{
+	uint64_t a0 = be64_to_cpu(a->q[0]), a1 = be64_to_cpu(a->q[1]);
+	uint64_t vh = be64_to_cpu(b->q[0]), vl = be64_to_cpu(b->q[1]);
+	uint64_t zh = 0, zl = 0, mask, r;
+	int i;
+
+	for (i = 0; i < 128; i++) {
+		/* bit i of a, in GHASH's reflected order */
+		mask = -(((i < 64) ? (a0 >> (63 - i)) : (a1 >> (127 - i))) & 1);
+		zh ^= vh & mask;
+		zl ^= vl & mask;
+		r = -(vl & 1) & (0xe1ULL << 56);
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ r;
+	}
+	a->q[0] = cpu_to_be64(zh);
+	a->q[1] = cpu_to_be64(zl);
 }
 
 /* inplace GFMUL for xts mode */
@@ -70,3 +146,95 @@ void gf_mulx(block128 *a)
 	a->q[0] = cpu_to_le64(le64_to_cpu(a->q[0]) << 1) ^ r;
 }
 
+/* alpha^(2^k) for k = 7 .. 31, as the low and high words of gf_mulx's little
+ * endian representation. smaller powers are at most 127 gf_mulx. */
+static const uint64_t xts_alpha_pow2[25][2] = {
+	{ 0x0000000000000087ULL, 0x0000000000000000ULL }, /* 7 */
+	{ 0x0000000000004015ULL, 0x0000000000000000ULL }, /* 8 */
+	{ 0x0000000010000111ULL, 0x0000000000000000ULL }, /* 9 */
+	{ 0x0100000000010101ULL, 0x0000000000000000ULL }, /* 10 */
+	{ 0x0000000100010001ULL, 0x0001000000000000ULL }, /* 11 */
+	{ 0x0000000100000001ULL, 0x0000008700000001ULL }, /* 12 */
+	{ 0x0000000000000086ULL, 0x000000000021caeaULL }, /* 13 */
+	{ 0x00021cae93f7cfc8ULL, 0x0000000000000000ULL }, /* 14 */
+	{ 0x4105551550555040ULL, 0x0000000401504454ULL }, /* 15 */
+	{ 0x118fe6196978ef70ULL, 0x1001001111110961ULL }, /* 16 */
+	{ 0x93c692c775187987ULL, 0x860140d2541486c6ULL }, /* 17 */
+	{ 0xea618e11df04ea1eULL, 0x8b69509b312d6501ULL }, /* 18 */
+	{ 0xcad0352d30b311b4ULL, 0xb715594eb7756558ULL }, /* 19 */
+	{ 0x54e1a6f865fe82b9ULL, 0x01afdeffd35e5fdeULL }, /* 20 */
+	{ 0x218289f09c0659edULL, 0x11b4a30358935542ULL }, /* 21 */
+	{ 0x97b14587eebe264dULL, 0x83a513579eda5793ULL }, /* 22 */
+	{ 0x38d15180f9de45adULL, 0x83ad91f69582bddfULL }, /* 23 */
+	{ 0x1a97936b620f481dULL, 0xc7f8a41756ad614dULL }, /* 24 */
+	{ 0xe94bf5687ccf4c39ULL, 0xbb844bf6957599a6ULL }, /* 25 */
+	{ 0x5aadb3837634c244ULL, 0x2c3bd83d0661350dULL }, /* 26 */
+	{ 0x1f726995c3f33829ULL, 0x24f6fc2353c7f232ULL }, /* 27 */
+	{ 0xa5b7efc52c5e9c53ULL, 0x150e344316f35f82ULL }, /* 28 */
+	{ 0x891738c79d5ad319ULL, 0xcbe66ebbc72d228aULL }, /* 29 */
+	{ 0xfbb824714f38f6c2ULL, 0xd331a77342cf2867ULL }, /* 30 */
+	{ 0x62609e6968de22b0ULL, 0x60dcdee4d2f1fc92ULL }, /* 31 */
+};
+
+/* inplace a = a * b for xts, one bit of b at a time, without branches on a */
+static void gf_mulx_by(block128 *a, const uint64_t b[2])
+{
+	uint64_t a0 = le64_to_cpu(a->q[0]), a1 = le64_to_cpu(a->q[1]);
+	uint64_t z0 = 0, z1 = 0, mask, r;
+	int i;
+
+	for (i = 0; i < 128; i++) {
+		/* z += a * x^i when bit i of b is set */
+		mask = -((b[i / 64] >> (i % 64)) & 1);
+		z0 ^= a0 & mask;
+		z1 ^= a1 & mask;
+		r = -(a1 >> 63) & 0x87;
+		a1 = (a1 << 1) | (a0 >> 63);
+		a0 = (a0 << 1) ^ r;
+	}
+	a->q[0] = cpu_to_le64(z0);
+	a->q[1] = cpu_to_le64(z1);
+}
+
+/* inplace a = a * alpha^n, the same as n gf_mulx, in a number of steps
+ * logarithmic in n: one multiplication per set bit of n above the 7th, and
+ * at most 127 gf_mulx for the low bits. the cost depends on n, which is the
+ * sector number and not a secret. */
+void gf_mulx_pow(block128 *a, uint32_t n)
+{
+	int k;
+
+	for (k = 7; k < 32; k++)
+		if ((n >> k) & 1)
+			gf_mulx_by(a, xts_alpha_pow2[k - 7]);
+	for (n &= 127; n > 0; n--)
+		gf_mulx(a);
+}
+
+/* doubling in GF(2^128) as defined by OCB, big endian */
+void ocb_block_double(block128 *d, block128 *s)
+{
+	unsigned int i;
+	uint8_t tmp = s->b[0];
+
+	for (i=0; i<15; i++)
+		d->b[i] = (s->b[i] << 1) | (s->b[i+1] >> 7);
+	d->b[15] = (s->b[15] << 1) ^ ((tmp >> 7) * 0x87);
+}
+
+/* get L_{ntz(i)} from the cached L_0 .. L_3, doubling the last one as needed */
+void ocb_get_L_i(block128 *l, block128 *lis, unsigned int i)
+{
+#define L_CACHED 4
+	i = bitfn_ntz(i);
+	if (i < L_CACHED) {
+		block128_copy(l, &lis[i]);
+	} else {
+		i -= (L_CACHED - 1);
+		block128_copy(l, &lis[L_CACHED - 1]);
+		while (i--) {
+			ocb_block_double(l, l);
+		}
+	}
+#undef L_CACHED
+}
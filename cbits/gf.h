@@ -32,7 +32,14 @@
 
 #include "block128.h"
 
+void gf_ghash_init(block128 *htable, block128 *h);
+void gf_ghash_mul(block128 *a, block128 *htable);
+void gf_ghash_blocks(block128 *tag, block128 *htable, uint8_t *input, uint32_t nb_blocks);
 void gf_mul(block128 *a, block128 *b);
 void gf_mulx(block128 *a);
+void gf_mulx_pow(block128 *a, uint32_t n);
+
+void ocb_block_double(block128 *d, block128 *s);
+void ocb_get_L_i(block128 *l, block128 *lis, unsigned int i);
 
 #endif